@@ -0,0 +1,63 @@
+"""
+Local HTTPS stand-in for the chat completions endpoint, for the ChatDM commandlet's -ConnectionCheck run.
+
+    python3 Scripts/ConnectionStandIn.py [--port 8443]
+
+Answers every HEAD (and GET) with 200 over HTTP/1.1 keep-alive, so a client that reuses its connection skips the
+TCP and TLS handshakes on every request after the first. Makes a self-signed localhost certificate with openssl on
+first run, so the game has to be started with n.VerifyPeer=false. Each new connection is logged, which shows
+directly whether the warm requests really reused one.
+"""
+
+import argparse
+import http.server
+import os
+import ssl
+import subprocess
+
+CERT_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), ".standin")
+CERT_FILE = os.path.join(CERT_DIR, "cert.pem")
+KEY_FILE = os.path.join(CERT_DIR, "key.pem")
+
+
+class StandInHandler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def setup(self):
+        super().setup()
+        print(f"New connection from {self.client_address[0]}:{self.client_address[1]}", flush=True)
+
+    def do_HEAD(self):
+        self.send_response(200)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    def do_GET(self):
+        self.do_HEAD()
+
+
+def ensure_certificate():
+    if os.path.exists(CERT_FILE) and os.path.exists(KEY_FILE):
+        return
+    os.makedirs(CERT_DIR, exist_ok=True)
+    subprocess.run(["openssl", "req", "-x509", "-newkey", "rsa:2048", "-nodes", "-days", "365", "-subj", "/CN=localhost",
+                    "-keyout", KEY_FILE, "-out", CERT_FILE], check=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=8443)
+    args = parser.parse_args()
+
+    ensure_certificate()
+    context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    context.load_cert_chain(CERT_FILE, KEY_FILE)
+
+    server = http.server.ThreadingHTTPServer(("localhost", args.port), StandInHandler)
+    server.socket = context.wrap_socket(server.socket, server_side=True)
+    print(f"Listening on https://localhost:{args.port}/v1/chat/completions", flush=True)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
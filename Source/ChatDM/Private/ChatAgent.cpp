@@ -1,148 +1,1027 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "ChatAgent.h"
+#include "ChatCompletionParser.h"
+#include "ChatConnection.h"
+#include "ChatMetrics.h"
+#include "ChatPromptLibrary.h"
+#include "ChatRateLimiter.h"
+#include "ChatResponseCache.h"
+#include "ChatResponseSchema.h"
+#include "ChatRequestWriter.h"
+#include "ChatTokenizer.h"
+#include "Containers/Ticker.h"
 #include "HttpModule.h"
 #include "Interfaces/IHttpResponse.h"
-#include "Dom/JsonObject.h"
-#include "Serialization/JsonSerializer.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+namespace ChatAgentResponse
+{
+	/** Tracks how much of a server-sent event body has been consumed and the content assembled from it so far. */
+	struct FStreamState
+	{
+		int32 ParsedBytes = 0;
+		bool bDone = false;
+		FString Content;
+		FChatCompletionUsage Usage;
+
+		/** When the first response bytes arrived, 0 until then. */
+		double FirstByteTime = 0.0;
+
+		/** Time spent consuming events so far. */
+		double ParseSeconds = 0.0;
+	};
+
+	/** Point a request at the chat completions endpoint with our headers. */
+	void SetRequestHeaders(const FHttpRequestRef& Request);
+
+	/** Log the token counts from a usage object. */
+	void LogUsage(const FChatCompletionUsage& Usage)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Prompt Tokens: %d, Completion Tokens: %d, Total Tokens: %d"), Usage.PromptTokens, Usage.CompletionTokens, Usage.TotalTokens);
+	}
+
+	/** The usage of one answered request, in the form the metrics sum it up. */
+	FChatTokenUsage ToTokenUsage(const FChatCompletionUsage& Usage)
+	{
+		FChatTokenUsage TokenUsage;
+		TokenUsage.Requests = 1;
+		TokenUsage.PromptTokens = Usage.PromptTokens;
+		TokenUsage.CompletionTokens = Usage.CompletionTokens;
+		TokenUsage.CachedTokens = Usage.CachedTokens;
+		return TokenUsage;
+	}
+
+	/**
+	 * Consume every complete SSE line past State.ParsedBytes and forward content deltas.
+	 * When bFlush is set the trailing line is treated as complete even without a newline (end of body).
+	 */
+	void ConsumeEvents(const TArray<uint8>& Body, FStreamState& State, const TFunction<void(const FString& Delta)>& OnDelta, const bool bFlush)
+	{
+		while (!State.bDone && State.ParsedBytes < Body.Num())
+		{
+			const uint8* LineStart = Body.GetData() + State.ParsedBytes;
+			const int32 Remaining = Body.Num() - State.ParsedBytes;
+
+			int32 LineLength = 0;
+			while (LineLength < Remaining && LineStart[LineLength] != '\n')
+			{
+				++LineLength;
+			}
+
+			// Wait for the rest of the line unless the body is finished
+			const bool bHasNewline = LineLength < Remaining;
+			if (!bHasNewline && !bFlush)
+			{
+				return;
+			}
+			State.ParsedBytes += bHasNewline ? LineLength + 1 : LineLength;
+
+			// Only "data:" lines carry payloads; blank lines and comments just separate events
+			constexpr int32 DataPrefixLength = 5;
+			if (LineLength < DataPrefixLength || FMemory::Memcmp(LineStart, "data:", DataPrefixLength) != 0)
+			{
+				continue;
+			}
+
+			const uint8* Data = LineStart + DataPrefixLength;
+			int32 DataLength = LineLength - DataPrefixLength;
+			while (DataLength > 0 && (*Data == ' ' || *Data == '\t'))
+			{
+				++Data;
+				--DataLength;
+			}
+			while (DataLength > 0 && (Data[DataLength - 1] == '\r' || Data[DataLength - 1] == ' '))
+			{
+				--DataLength;
+			}
+
+			if (DataLength == 6 && FMemory::Memcmp(Data, "[DONE]", 6) == 0)
+			{
+				State.bDone = true;
+				return;
+			}
+
+			// Content deltas live under choices[0].delta.content, with include_usage the final chunk only carries usage
+			FChatCompletionResult Chunk;
+			if (!FChatCompletionParser::ParseChunk(Data, DataLength, Chunk))
+			{
+				const FUTF8ToTCHAR ChunkText(reinterpret_cast<const ANSICHAR*>(Data), DataLength);
+				UE_LOG(LogTemp, Error, TEXT("ChatAgentResponse::ConsumeEvents(): failed to parse chunk: %s"), *FString(ChunkText.Length(), ChunkText.Get()));
+				continue;
+			}
+
+			if (Chunk.Usage.bValid)
+			{
+				LogUsage(Chunk.Usage);
+				State.Usage = Chunk.Usage;
+			}
+
+			if (Chunk.bHasContent && !Chunk.Content.IsEmpty())
+			{
+				State.Content += Chunk.Content;
+				if (OnDelta)
+				{
+					OnDelta(Chunk.Content);
+				}
+			}
+		}
+	}
+}
+
+UChatAgent::UChatAgent()
+{
+	ModelTiers.Add(FChatModelTier(TEXT("gpt-4o-mini"), 0));
+	ModelTiers.Add(FChatModelTier(TEXT("gpt-4o"), 0));
+}
 
 void UChatAgent::Initialize(const FString& InPrompt)
 {
 	SystemMessage = FChatMessage("system", InPrompt);
 }
 
-void UChatAgent::SendMessage(TArray<FChatMessage>& MessageLog,
-                             TFunction<void(const FString& ResponseContent)> OnResponseCallback)
+void UChatAgent::SetDungeon(const FWorldState& State)
+{
+	// A big map in every request would undo the point of a neighborhood view, those agents keep getting the rooms they see inline
+	if (WorldStateView.Scope == EWorldStateScope::Neighborhood && State.Rooms.Num() > MaxDungeonMessageRooms)
+	{
+		UE_LOG(LogTemp, Log, TEXT("UChatAgent::SetDungeon(): %s has a neighborhood view of a %d room dungeon, more than %d, so it gets no DUNGEON message."), *GetName(), State.Rooms.Num(), MaxDungeonMessageRooms);
+		DungeonMessage = FChatMessage();
+		return;
+	}
+
+	// Always the whole map, so the message is the same whichever room the player is in
+	FWorldStateViewSettings DungeonView = WorldStateView;
+	DungeonView.Scope = EWorldStateScope::FullWorld;
+
+	DungeonMessage = FChatMessage("system", FString::Printf(
+		TEXT("DUNGEON (the rooms' names, descriptions and exits, which never change; WORLDSTATE blocks only give what can change and refer to rooms by roomIndex):\n%s"),
+		*FWorldStateView::ToJson(State, DungeonView, EWorldStateParts::Static)));
+}
+
+/** Everything a request needs across its attempts: the first one, retries after failures and hedged duplicates. */
+struct FChatRequestState : public TSharedFromThis<FChatRequestState>
+{
+	/** The callbacks are the agent's (and capture it), so none of them may run once the agent has been destroyed. */
+	TWeakObjectPtr<UChatAgent> Agent;
+	FChatRetryPolicy Policy;
+
+	bool bStream = false;
+	TFunction<void(const FString& ResponseContent)> OnResponseCallback;
+	TFunction<void(const FString& Delta)> OnDeltaCallback;
+	TFunction<void()> OnErrorCallback;
+
+	bool bUseCache = false;
+	FSHAHash CacheKey;
+
+	/** The model the request was sent to, for its latency stats. */
+	FString Model;
+
+	EChatRequestPriority Priority = EChatRequestPriority::Interactive;
+
+	/** What each attempt is expected to cost against the token rate limit. */
+	int32 EstimatedTokens = 0;
+
+	/** Attempts waiting on the rate limiter. */
+	int32 QueuedAttempts = 0;
+
+	FChatRequestMetrics Metrics;
+
+	/** The first attempt. Retries and hedges are sent with a copy of its body. */
+	FHttpRequestPtr FirstRequest;
+
+	/** Attempts that haven't completed yet. */
+	TArray<FHttpRequestPtr> InFlight;
+
+	/** Pending hedge and retry timers. */
+	TArray<FTSTicker::FDelegateHandle> Timers;
+
+	/** The hedge timer while one is pending. */
+	FTSTicker::FDelegateHandle HedgeTimer;
+
+	/** The attempt whose stream reached the caller first. Every other attempt is dropped once it is set. */
+	FHttpRequestPtr StreamOwner;
+
+	double StartTime = 0.0;
+	int32 Retries = 0;
+	bool bHedged = false;
+	bool bCancelled = false;
+	bool bFinished = false;
+
+	/** A new attempt with the same URL, headers and body as the first. */
+	FHttpRequestRef CreateAttempt() const;
+
+	/** Send an attempt once the shared rate limits have room for it. */
+	void Admit(const FHttpRequestRef& Request, EChatRequestPriority AttemptPriority);
+
+	/** Bind an attempt's callbacks and send it. */
+	void Launch(const FHttpRequestRef& Request);
+
+	/** Send a duplicate of the request after the agent's p95 latency, if it still hasn't answered by then. */
+	void ScheduleHedge();
+
+	/** Drop the pending hedge, if there is one. */
+	void ClearHedge();
+
+	void HandleDelta(const FHttpRequestPtr& Request, const FString& Delta, double AttemptStartTime);
+	void HandleAttemptComplete(const FHttpRequestPtr& Request, const FHttpResponsePtr& Response, bool bWasSuccessful, ChatAgentResponse::FStreamState& StreamState, double AttemptStartTime);
+
+	/** Retry a failed attempt if the policy allows it, otherwise fail the request. */
+	void HandleAttemptFailure(const FHttpResponsePtr& Response);
+
+	void Succeed(const FString& Content);
+	void Fail();
+	void Cancel();
+
+	/** Run Callback after DelaySeconds unless the request is over by then. */
+	FTSTicker::FDelegateHandle AddTimer(float DelaySeconds, TFunction<void()> Callback);
+
+	/** Drop all timers and cancel every attempt except Except. */
+	void Stop(const FHttpRequestPtr& Except);
+};
+
+void ChatAgentResponse::SetRequestHeaders(const FHttpRequestRef& Request)
+{
+	Request->SetURL(FChatConnection::Get().GetEndpoint());
+	Request->SetVerb(TEXT("POST"));
+	Request->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
+	Request->SetHeader(TEXT("Authorization"), FString::Printf(TEXT("Bearer %s"), TEXT("")));
+}
+
+FHttpRequestRef FChatRequestState::CreateAttempt() const
+{
+	const FHttpRequestRef Request = FHttpModule::Get().CreateRequest();
+	ChatAgentResponse::SetRequestHeaders(Request);
+	Request->SetContent(FirstRequest->GetContent());
+	return Request;
+}
+
+void FChatRequestState::Admit(const FHttpRequestRef& Request, const EChatRequestPriority AttemptPriority)
+{
+	++QueuedAttempts;
+	const double QueuedTime = FPlatformTime::Seconds();
+	const double Deadline = Policy.DeadlineSeconds > 0.0f ? StartTime + Policy.DeadlineSeconds : 0.0;
+	FChatRateLimiter::Get().Submit(AttemptPriority, EstimatedTokens,
+		[State = AsShared(), Request, QueuedTime]()
+		{
+			--State->QueuedAttempts;
+			State->Metrics.QueueSeconds += FPlatformTime::Seconds() - QueuedTime;
+
+			// The request may have been answered or given up on while this attempt waited its turn
+			if (State->bFinished || State->bCancelled || !State->Agent.IsValid())
+			{
+				return false;
+			}
+
+			State->Launch(Request);
+			return true;
+		},
+		Deadline,
+		[State = AsShared(), QueuedTime]()
+		{
+			--State->QueuedAttempts;
+			State->Metrics.QueueSeconds += FPlatformTime::Seconds() - QueuedTime;
+
+			if (State->bFinished || State->bCancelled || !State->Agent.IsValid())
+			{
+				return;
+			}
+
+			// Never sent, so it fails like an attempt that got no response. Past the deadline that means no retry.
+			UE_LOG(LogTemp, Error, TEXT("UChatAgent::SendMessage(): An attempt was still waiting on the rate limits at the %.1fs deadline."), State->Policy.DeadlineSeconds);
+			State->HandleAttemptFailure(nullptr);
+		});
+}
+
+void FChatRequestState::Launch(const FHttpRequestRef& Request)
+{
+	if (Policy.AttemptTimeoutSeconds > 0.0f)
+	{
+		Request->SetTimeout(Policy.AttemptTimeoutSeconds);
+	}
+
+	const double AttemptStartTime = FPlatformTime::Seconds();
+	const bool bConnectionWarm = FChatConnection::Get().IsWarm();
+	const TSharedRef<ChatAgentResponse::FStreamState> StreamState = MakeShared<ChatAgentResponse::FStreamState>();
+
+	++Metrics.Attempts;
+
+	// The callbacks keep the state alive, callers are free to drop the handle of a request they'll never cancel
+	// Progress fires on the game thread as bytes arrive: note the first byte, and when streaming parse whatever complete events we have so far
+	Request->OnRequestProgress64().BindLambda(
+		[State = AsShared(), StreamState, AttemptStartTime](FHttpRequestPtr ProgressRequest, uint64 BytesSent, uint64 BytesReceived)
+		{
+			if (BytesReceived > 0 && StreamState->FirstByteTime == 0.0)
+			{
+				StreamState->FirstByteTime = FPlatformTime::Seconds();
+			}
+
+			if (!State->bStream || State->bFinished || State->bCancelled || (State->StreamOwner.IsValid() && State->StreamOwner != ProgressRequest))
+			{
+				return;
+			}
+
+			if (const FHttpResponsePtr Response = ProgressRequest->GetResponse(); Response.IsValid() && BytesReceived > 0)
+			{
+				const double ParseStartTime = FPlatformTime::Seconds();
+				ChatAgentResponse::ConsumeEvents(Response->GetContent(), *StreamState,
+					[&State, &ProgressRequest, AttemptStartTime](const FString& Delta)
+					{
+						State->HandleDelta(ProgressRequest, Delta, AttemptStartTime);
+					},
+					false);
+				StreamState->ParseSeconds += FPlatformTime::Seconds() - ParseStartTime;
+			}
+		});
+
+	Request->OnProcessRequestComplete().BindLambda(
+		[State = AsShared(), StreamState, AttemptStartTime, bConnectionWarm](FHttpRequestPtr CompletedRequest, const FHttpResponsePtr& Response, const bool bWasSuccessful)
+		{
+			if (Response.IsValid())
+			{
+				FChatConnection::Get().NoteRequestComplete(bConnectionWarm, FPlatformTime::Seconds() - AttemptStartTime);
+			}
+			State->HandleAttemptComplete(CompletedRequest, Response, bWasSuccessful, *StreamState, AttemptStartTime);
+		});
+
+	InFlight.Add(Request);
+	Request->ProcessRequest();
+
+	// The hedge delay counts from when the original actually went out, not from however long it sat in the rate limiter
+	if (Policy.bHedgeRequests && Request == FirstRequest)
+	{
+		ScheduleHedge();
+	}
+}
+
+void FChatRequestState::ScheduleHedge()
+{
+	const UChatAgent* AgentPtr = Agent.Get();
+	const float HedgeDelay = AgentPtr ? AgentPtr->GetHedgeDelay() : Policy.DefaultHedgeDelaySeconds;
+
+	HedgeTimer = AddTimer(HedgeDelay, [this, HedgeDelay]()
+	{
+		HedgeTimer.Reset();
+
+		// Only while the original is still running and hasn't started streaming
+		if (bHedged || StreamOwner.IsValid() || InFlight.IsEmpty())
+		{
+			return;
+		}
+		bHedged = true;
+
+		// A duplicate is a nice-to-have, it shouldn't take rate limit room from anyone's first attempt
+		UE_LOG(LogTemp, Log, TEXT("UChatAgent::SendMessage(): No answer after %.2fs, sending a hedged request."), HedgeDelay);
+		Admit(CreateAttempt(), Priority == EChatRequestPriority::Interactive ? EChatRequestPriority::Speculative : Priority);
+	});
+}
+
+void FChatRequestState::ClearHedge()
+{
+	if (HedgeTimer.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(HedgeTimer);
+		Timers.Remove(HedgeTimer);
+		HedgeTimer.Reset();
+	}
+}
+
+void FChatRequestState::HandleDelta(const FHttpRequestPtr& Request, const FString& Delta, const double AttemptStartTime)
+{
+	// The first attempt to produce text wins, everything else would only show the player a second version of it
+	if (!StreamOwner.IsValid())
+	{
+		StreamOwner = Request;
+		Stop(Request);
+
+		const float Latency = FPlatformTime::Seconds() - AttemptStartTime;
+		FChatModelRouter::Get().RecordLatency(Model, EChatLatencyKind::FirstToken, Latency);
+		if (UChatAgent* AgentPtr = Agent.Get())
+		{
+			AgentPtr->RecordLatency(Latency);
+		}
+	}
+
+	if (OnDeltaCallback && Agent.IsValid())
+	{
+		OnDeltaCallback(Delta);
+	}
+}
+
+void FChatRequestState::HandleAttemptComplete(const FHttpRequestPtr& Request, const FHttpResponsePtr& Response, const bool bWasSuccessful, ChatAgentResponse::FStreamState& StreamState, const double AttemptStartTime)
+{
+	InFlight.Remove(Request);
+
+	// Every response says where we stand against the rate limits, even one we're about to ignore
+	const bool bHasRateLimitHeaders = FChatRateLimiter::Get().NoteResponse(Response);
+
+	if (bFinished || bCancelled || (StreamOwner.IsValid() && StreamOwner != Request))
+	{
+		return;
+	}
+
+	// Ensure our HTTP was successful and we received a valid response
+	if (!bWasSuccessful || !Response.IsValid() || !EHttpResponseCodes::IsOk(Response->GetResponseCode()))
+	{
+		if (Response.IsValid())
+		{
+			UE_LOG(LogTemp, Error, TEXT("HTTP Request failed: %d - %s"), Response->GetResponseCode(), *Response->GetContentAsString());
+		}
+		else
+		{
+			UE_LOG(LogTemp, Error, TEXT("HTTP Request failed and response is invalid."));
+		}
+		HandleAttemptFailure(Response);
+		return;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(ChatDM_HandleResponse);
+
+	const double CompleteTime = FPlatformTime::Seconds();
+	Metrics.HttpSeconds = CompleteTime - AttemptStartTime;
+	Metrics.FirstByteSeconds = (StreamState.FirstByteTime > 0.0 ? StreamState.FirstByteTime : CompleteTime) - AttemptStartTime;
+	FChatModelRouter::Get().RecordLatency(Model, EChatLatencyKind::Total, Metrics.HttpSeconds);
+
+	if (bStream)
+	{
+		// Pick up anything that arrived after the last progress tick
+		ChatAgentResponse::ConsumeEvents(Response->GetContent(), StreamState,
+			[this, &Request, AttemptStartTime](const FString& Delta)
+			{
+				HandleDelta(Request, Delta, AttemptStartTime);
+			},
+			true);
+		Metrics.ParseSeconds = StreamState.ParseSeconds + (FPlatformTime::Seconds() - CompleteTime);
+		UE_LOG(LogTemp, Log, TEXT("ChatGPT Response (streamed): %s"), *StreamState.Content);
+
+		if (StreamState.Usage.bValid)
+		{
+			Metrics.Usage = ChatAgentResponse::ToTokenUsage(StreamState.Usage);
+		}
+
+		if (!bHasRateLimitHeaders && StreamState.Usage.bValid)
+		{
+			FChatRateLimiter::Get().NoteUsage(EstimatedTokens, StreamState.Usage.TotalTokens);
+		}
+
+		// Hand over the assembled message once, exactly like the non-streamed path
+		Succeed(StreamState.Content);
+		return;
+	}
+
+	UE_LOG(LogTemp, Verbose, TEXT("HTTP Request successful: %s"), *Response->GetContentAsString());
+
+	if (UChatAgent* AgentPtr = Agent.Get())
+	{
+		AgentPtr->RecordLatency(Metrics.HttpSeconds);
+	}
+
+	// Pull choices[0].message.content and usage straight out of the response bytes
+	const TArray<uint8>& Body = Response->GetContent();
+	FChatCompletionResult Result;
+	if (!FChatCompletionParser::ParseCompletion(Body.GetData(), Body.Num(), Result))
+	{
+		UE_LOG(LogTemp, Error, TEXT("UChatAgent::SendMessage(): failed to parse the JSON response: %s"), *Response->GetContentAsString());
+	}
+	Metrics.ParseSeconds = FPlatformTime::Seconds() - CompleteTime;
+
+	// Track token usage
+	if (Result.Usage.bValid)
+	{
+		ChatAgentResponse::LogUsage(Result.Usage);
+		Metrics.Usage = ChatAgentResponse::ToTokenUsage(Result.Usage);
+
+		// Without the headers our own estimate is all the token bucket has to go on, so keep it honest
+		if (!bHasRateLimitHeaders)
+		{
+			FChatRateLimiter::Get().NoteUsage(EstimatedTokens, Result.Usage.TotalTokens);
+		}
+	}
+	else
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to retrieve 'usage' field as an object."));
+	}
+
+	if (!Result.bHasContent)
+	{
+		UE_LOG(LogTemp, Error, TEXT("UChatAgent::SendMessage(): no choices[0].message.content in the JSON response."));
+		Fail();
+		return;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("ChatGPT Response: %s"), *Result.Content);
+	Succeed(Result.Content);
+}
+
+void FChatRequestState::HandleAttemptFailure(const FHttpResponsePtr& Response)
+{
+	// A hedge (or the original it duplicated) is still running or waiting to be sent, and may yet answer
+	if (!InFlight.IsEmpty() || QueuedAttempts > 0)
+	{
+		return;
+	}
+
+	// Part of the reply has already been shown, a fresh attempt would show it all again
+	if (StreamOwner.IsValid())
+	{
+		Fail();
+		return;
+	}
+
+	// Timeouts, dropped connections, rate limits and server errors are worth another try, anything else will fail the same way again
+	const int32 ResponseCode = Response.IsValid() ? Response->GetResponseCode() : 0;
+	const bool bRetryable = !Response.IsValid()
+		|| ResponseCode == EHttpResponseCodes::RequestTimeout
+		|| ResponseCode == EHttpResponseCodes::TooManyRequests
+		|| ResponseCode >= EHttpResponseCodes::ServerError;
+	if (!bRetryable || Retries >= Policy.MaxRetries)
+	{
+		Fail();
+		return;
+	}
+
+	// Exponential backoff with jitter so a burst of failed requests doesn't come back as another burst
+	const float BackoffCap = FMath::Min(Policy.MaxBackoffSeconds, Policy.InitialBackoffSeconds * static_cast<float>(1 << FMath::Min(Retries, 16)));
+	float Delay = BackoffCap * FMath::FRandRange(0.5f, 1.0f);
+	if (Response.IsValid())
+	{
+		const FString RetryAfter = Response->GetHeader(TEXT("Retry-After"));
+		if (RetryAfter.IsNumeric())
+		{
+			Delay = FMath::Max(Delay, FCString::Atof(*RetryAfter));
+		}
+	}
+
+	const double Elapsed = FPlatformTime::Seconds() - StartTime;
+	if (Policy.DeadlineSeconds > 0.0f && Elapsed + Delay >= Policy.DeadlineSeconds)
+	{
+		UE_LOG(LogTemp, Error, TEXT("UChatAgent::SendMessage(): A retry would miss the %.1fs deadline, giving up."), Policy.DeadlineSeconds);
+		Fail();
+		return;
+	}
+
+	// The original is gone, and a retry gets no hedge of its own
+	ClearHedge();
+
+	++Retries;
+	UE_LOG(LogTemp, Warning, TEXT("UChatAgent::SendMessage(): Retrying in %.2fs (retry %d of %d)."), Delay, Retries, Policy.MaxRetries);
+	AddTimer(Delay, [this]()
+	{
+		Admit(CreateAttempt(), Priority);
+	});
+}
+
+void FChatRequestState::Succeed(const FString& Content)
+{
+	bFinished = true;
+	Stop(nullptr);
+
+	if (bUseCache && !Content.IsEmpty())
+	{
+		FChatResponseCache::Get().Add(CacheKey, Content, FPlatformTime::Seconds() - StartTime);
+	}
+
+	// The finished attempts still hold their callbacks (and through them this state), so let go of them
+	FirstRequest.Reset();
+	StreamOwner.Reset();
+
+	if (UChatAgent* AgentPtr = Agent.Get())
+	{
+		// Recorded first so whoever handles the reply can read them off the agent
+		Metrics.TotalSeconds = FPlatformTime::Seconds() - StartTime;
+		AgentPtr->RecordRequestMetrics(Metrics);
+
+		OnResponseCallback(Content);
+	}
+}
+
+void FChatRequestState::Fail()
+{
+	bFinished = true;
+	Stop(nullptr);
+	FirstRequest.Reset();
+	StreamOwner.Reset();
+
+	if (OnErrorCallback && Agent.IsValid())
+	{
+		OnErrorCallback();
+	}
+}
+
+void FChatRequestState::Cancel()
 {
-	const FString OpenAiUrl = TEXT("https://api.openai.com/v1/chat/completions");
+	bCancelled = true;
+	Stop(nullptr);
+	FirstRequest.Reset();
+	StreamOwner.Reset();
+}
 
-	// Set up the HTTP request
-	const TSharedRef<IHttpRequest> HttpRequest = FHttpModule::Get().CreateRequest();
-	HttpRequest->SetURL(OpenAiUrl);
-	HttpRequest->SetVerb(TEXT("POST"));
-	HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
-	HttpRequest->SetHeader(TEXT("Authorization"), FString::Printf(TEXT("Bearer %s"), TEXT("")));
+FTSTicker::FDelegateHandle FChatRequestState::AddTimer(const float DelaySeconds, TFunction<void()> Callback)
+{
+	return Timers.Add_GetRef(FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda(
+		[State = AsShared(), Callback = MoveTemp(Callback)](float)
+		{
+			if (!State->bFinished && !State->bCancelled && State->Agent.IsValid())
+			{
+				Callback();
+			}
+			return false;
+		}),
+		DelaySeconds));
+}
 
-	TArray<TSharedPtr<FJsonValue>> MessagesArray;
+void FChatRequestState::Stop(const FHttpRequestPtr& Except)
+{
+	for (const FTSTicker::FDelegateHandle& Timer : Timers)
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(Timer);
+	}
+	Timers.Reset();
+	HedgeTimer.Reset();
 
-	// Translate the MessageLog to JSON for the upcoming HTTP request.
+	TArray<FHttpRequestPtr> Attempts = MoveTemp(InFlight);
+	for (const FHttpRequestPtr& Attempt : Attempts)
+	{
+		if (Attempt == Except)
+		{
+			InFlight.Add(Attempt);
+			continue;
+		}
+
+		// Unbind first so the cancellation doesn't get reported as a failed request
+		Attempt->OnProcessRequestComplete().Unbind();
+		Attempt->OnRequestProgress64().Unbind();
+		Attempt->CancelRequest();
+	}
+}
+
+void FChatRequestHandle::Cancel()
+{
+	if (State.IsValid() && !State->bCancelled)
+	{
+		State->Cancel();
+	}
+}
+
+bool FChatRequestHandle::IsCancelled() const
+{
+	return State.IsValid() && State->bCancelled;
+}
+
+bool FChatRequestHandle::IsActive() const
+{
+	return State.IsValid() && !State->bCancelled && !State->bFinished;
+}
+
+void UChatAgent::CancelRequests()
+{
+	if (ActiveRequest.IsValid() && ActiveRequest->IsActive())
+	{
+		ActiveRequest->Cancel();
+		AbandonTurn();
+	}
+	ActiveRequest.Reset();
+}
+
+FChatRequestOptions UChatAgent::MakeTurnOptions(const FString& PlayerInput)
+{
+	FChatRequestOptions Options;
+	Options.OnErrorCallback = [this, PlayerInput]()
+	{
+		HandleRequestFailed(PlayerInput);
+	};
+	return Options;
+}
+
+void UChatAgent::HandleRequestFailed(const FString& PlayerInput)
+{
+	UE_LOG(LogTemp, Error, TEXT("UChatAgent::HandleRequestFailed(): %s gave up on the turn for '%s'."), *GetName(), *PlayerInput);
+
+	ActiveRequest.Reset();
+	AbandonTurn();
+
+	if (OnRequestFailed.IsBound())
+	{
+		OnRequestFailed.Broadcast(PlayerInput);
+	}
+}
+
+void UChatAgent::DropUnansweredMessage(TArray<FChatMessage>& MessageLog)
+{
+	if (!MessageLog.IsEmpty() && MessageLog.Last().Role == TEXT("user"))
+	{
+		MessageLog.Pop();
+	}
+}
+
+TSharedRef<FChatRequestHandle> UChatAgent::SendMessage(TArray<FChatMessage>& MessageLog,
+                             TFunction<void(const FString& ResponseContent)> OnResponseCallback,
+                             const FChatRequestOptions& Options)
+{
+	const TSharedRef<FChatRequestState> State = MakeShared<FChatRequestState>();
+	State->Agent = this;
+	State->Policy = RetryPolicy;
+	State->bStream = Options.bStream;
+	State->OnResponseCallback = MoveTemp(OnResponseCallback);
+	State->OnDeltaCallback = Options.OnDeltaCallback;
+	State->OnErrorCallback = Options.OnErrorCallback;
+	State->Priority = Options.Priority;
+	State->StartTime = FPlatformTime::Seconds();
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(ChatDM_BuildRequest);
+
+	const TSharedRef<FChatRequestHandle> RequestHandle = MakeShared<FChatRequestHandle>();
+	RequestHandle->State = State;
+
+	// The legend and DUNGEON messages are written after the system prompt but never live in the log, so count them up front
+	FChatTokenizer& Tokenizer = FChatTokenizer::Get();
+	const FString& Legend = FWorldStateView::GetFormatLegend(WorldStateView.Format);
+	const bool bWriteLegend = Options.bIncludeWorldStateLegend && !Legend.IsEmpty();
+	const bool bWriteDungeon = Options.bIncludeWorldStateLegend && HasDungeonMessage();
+	int32 InjectedTokens = 0;
+	if (bWriteLegend)
+	{
+		InjectedTokens += Tokenizer.CountTokens(Legend) + Tokenizer.CountTokens(TEXT("system")) + FChatTokenizer::TokensPerMessage;
+	}
+	if (bWriteDungeon)
+	{
+		InjectedTokens += Tokenizer.CountTokens(DungeonMessage);
+	}
+
+	// Drop whatever history this agent doesn't want to pay for before we serialize anything.
+	ApplyContextPolicy(MessageLog, InjectedTokens);
+
+	// Know what the prompt costs before it goes anywhere
+	State->Metrics.EstimatedPromptTokens = Tokenizer.CountTokens(MessageLog) + InjectedTokens;
+
+	// Write the request body straight to UTF-8. History messages were encoded on an earlier turn and are just copied.
+	TArray<uint8> Payload;
+	Payload.Reserve(LastPayloadSize + 1024);
+
+	// Specify the model of GPT we want to use: an explicit one, otherwise the tier the router picks for the budget
+	int32 MaxTokens = 0;
+	State->Model = Options.Model;
+	if (State->Model.IsEmpty())
+	{
+		const int32 Tier = Options.ModelTier != INDEX_NONE
+			? FMath::Min(Options.ModelTier, ModelTiers.Num() - 1)
+			: FChatModelRouter::Get().SelectTier(ModelTiers, DefaultModelTier, Options.LatencyBudgetSeconds,
+				Options.bStream ? EChatLatencyKind::FirstToken : EChatLatencyKind::Total);
+		if (ModelTiers.IsValidIndex(Tier))
+		{
+			State->Model = ModelTiers[Tier].Model;
+			MaxTokens = ModelTiers[Tier].MaxTokens;
+		}
+		else
+		{
+			State->Model = TEXT("gpt-4o-mini");
+		}
+	}
+	State->Metrics.Model = State->Model;
+
+	FChatRequestWriter::WriteRaw(Payload, "{\"model\":");
+	FChatRequestWriter::WriteString(Payload, State->Model);
+
+	// We need to pass the entire message array along with every message
 	// NOTE: We expect the System and the latest User messages to be in the received MessageLog.
-	if (MessageLog.Num() > 0)
+	FChatRequestWriter::WriteRaw(Payload, ",\"messages\":[");
+	for (int32 Index = 0; Index < MessageLog.Num(); ++Index)
 	{
-		UE_LOG(LogTemp, Log, TEXT("========== Translating message log =========="));
-		for (const FChatMessage& Message : MessageLog)
+		FChatMessage& Message = MessageLog[Index];
+		if (Index > 0)
+		{
+			FChatRequestWriter::WriteRaw(Payload, ",");
+		}
+
+		if (!Message.EncodedJson.IsValid())
 		{
-			TSharedPtr<FJsonObject> MessageObject = MakeShareable(new FJsonObject());
-			MessageObject->SetStringField(TEXT("role"), Message.Role);
-			MessageObject->SetStringField(TEXT("content"), Message.Content);
-			MessagesArray.Add(MakeShareable(new FJsonValueObject(MessageObject)));
 			UE_LOG(LogTemp, Log, TEXT("- %s: %s"), *Message.Role, *Message.Content);
 		}
+		FChatRequestWriter::WriteCachedMessage(Payload, Message);
+
+		// Explain a non-JSON-obvious world state encoding once, right after the system prompt
+		if (Index == 0 && bWriteLegend)
+		{
+			FChatRequestWriter::WriteRaw(Payload, ",");
+			FChatRequestWriter::WriteMessage(Payload, TEXT("system"), Legend);
+		}
+
+		// Then the fixed part of the world, identical in every request of every session playing this dungeon
+		if (Index == 0 && bWriteDungeon)
+		{
+			FChatRequestWriter::WriteRaw(Payload, ",");
+			FChatRequestWriter::WriteCachedMessage(Payload, DungeonMessage);
+		}
 	}
+	FChatRequestWriter::WriteRaw(Payload, "]");
 
-	// Set up the JSON object that will be sent in the POST request
-	const TSharedPtr<FJsonObject> JsonObject = MakeShareable(new FJsonObject());
-	// Specify the model of GPT we want to use
-	JsonObject->SetStringField(TEXT("model"), TEXT("gpt-4o"));
-	// We need to pass the entire message array along with every message
-	JsonObject->SetArrayField(TEXT("messages"), MessagesArray);
+	// Constrain the reply to our struct's schema, so it always decodes
+	if (bUseStructuredOutputs && ResponseStruct)
+	{
+		FChatRequestWriter::WriteRaw(Payload, ",\"response_format\":");
+		Payload.Append(*FChatResponseSchema::GetResponseFormat(ResponseStruct));
+	}
 
-	// Serialize the JSON into a string for sending
-	FString Payload;
-	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Payload);
-	FJsonSerializer::Serialize(JsonObject.ToSharedRef(), Writer);
-	HttpRequest->SetContentAsString(Payload);
+	if (MaxTokens > 0)
+	{
+		TAnsiStringBuilder<16> MaxTokensText;
+		MaxTokensText << MaxTokens;
+		FChatRequestWriter::WriteRaw(Payload, ",\"max_tokens\":");
+		FChatRequestWriter::WriteRaw(Payload, MaxTokensText.ToView());
+	}
 
-	// Bind to the response handler
-	// HttpRequest->OnProcessRequestComplete().BindUObject(this, &UChatGPTManager::HandleResponse);
+	// Everything that decides the reply has been written by now. Streaming only changes how it arrives, so it isn't part of the key.
+	State->bUseCache = Options.bUseCache || bCacheResponses;
+	if (State->bUseCache)
+	{
+		State->CacheKey = FChatResponseCache::MakeKey(Payload);
 
-	HttpRequest->OnProcessRequestComplete().BindLambda(
-		[OnResponseCallback](FHttpRequestPtr Request, const FHttpResponsePtr& Response, const bool bWasSuccessful)
+		FString CachedContent;
+		if (FChatResponseCache::Get().Find(State->CacheKey, CachedContent))
 		{
-			// Ensure our HTTP was successful and we received a valid response
-			if (!bWasSuccessful || !Response.IsValid())
+			UE_LOG(LogTemp, Log, TEXT("ChatGPT Response (cached): %s"), *CachedContent);
+			State->Metrics.BuildSeconds = FPlatformTime::Seconds() - State->StartTime;
+			State->Metrics.bFromCache = true;
+
+			// Deliver on the next tick like a real response would, callers don't expect their callbacks to run inside SendMessage
+			State->AddTimer(0.0f, [StatePtr = &State.Get(), CachedContent]()
 			{
-				if (Response.IsValid())
+				StatePtr->bFinished = true;
+				if (StatePtr->bStream && StatePtr->OnDeltaCallback)
 				{
-					UE_LOG(LogTemp, Error, TEXT("HTTP Request failed: %d - %s"), Response->GetResponseCode(), *Response->GetContentAsString());
+					StatePtr->OnDeltaCallback(CachedContent);
 				}
-				else
-				{
-					UE_LOG(LogTemp, Error, TEXT("HTTP Request failed and response is invalid."));
-				}
-				return;
-			}
-			
-			UE_LOG(LogTemp, Log, TEXT("HTTP Request successful: %s"), *Response->GetContentAsString());
 
-			// Deserialize the response into JSON
-			const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Response->GetContentAsString());
-			if (TSharedPtr<FJsonObject> JsonResponse; FJsonSerializer::Deserialize(Reader, JsonResponse))
+				StatePtr->Metrics.TotalSeconds = FPlatformTime::Seconds() - StatePtr->StartTime;
+				StatePtr->Agent->RecordRequestMetrics(StatePtr->Metrics);
+				StatePtr->OnResponseCallback(CachedContent);
+			});
+			return RequestHandle;
+		}
+	}
+
+	// Ask for server-sent events so the reply can be shown as it is generated.
+	// Streamed responses only report usage when asked to, in a final chunk.
+	if (Options.bStream)
+	{
+		FChatRequestWriter::WriteRaw(Payload, ",\"stream\":true,\"stream_options\":{\"include_usage\":true}");
+	}
+	FChatRequestWriter::WriteRaw(Payload, "}");
+
+	// Hand the bytes over without another copy, retries and hedges copy them from this request
+	LastPayloadSize = Payload.Num();
+	State->EstimatedTokens = FChatRateLimiter::EstimateRequestTokens(State->Metrics.EstimatedPromptTokens, MaxTokens);
+	State->Metrics.BuildSeconds = FPlatformTime::Seconds() - State->StartTime;
+	const FHttpRequestRef HttpRequest = FHttpModule::Get().CreateRequest();
+	ChatAgentResponse::SetRequestHeaders(HttpRequest);
+	HttpRequest->SetContent(MoveTemp(Payload));
+	State->FirstRequest = HttpRequest;
+
+	// Finally, send the request, or queue it behind more urgent ones when the rate limits are tight
+	State->Admit(HttpRequest, Options.Priority);
+	return RequestHandle;
+}
+
+void UChatAgent::RecordRequestMetrics(const FChatRequestMetrics& Metrics)
+{
+	LastRequestMetrics = Metrics;
+	LastRequestMetrics.Agent = GetName();
+	TokenUsage += Metrics.Usage;
+
+	FChatMetrics::ReportRequest(LastRequestMetrics);
+}
+
+void UChatAgent::RecordLatency(const float Seconds)
+{
+	constexpr int32 MaxLatencySamples = 64;
+	if (LatencySamples.Num() < MaxLatencySamples)
+	{
+		LatencySamples.Add(Seconds);
+	}
+	else
+	{
+		LatencySamples[NextLatencySample] = Seconds;
+	}
+	NextLatencySample = (NextLatencySample + 1) % MaxLatencySamples;
+}
+
+float UChatAgent::GetHedgeDelay() const
+{
+	// A p95 from a handful of samples is mostly noise
+	constexpr int32 MinLatencySamples = 10;
+	if (LatencySamples.Num() < MinLatencySamples)
+	{
+		return RetryPolicy.DefaultHedgeDelaySeconds;
+	}
+
+	TArray<float> Sorted = LatencySamples;
+	Sorted.Sort();
+	return Sorted[FMath::CeilToInt(0.95f * Sorted.Num()) - 1];
+}
+
+void UChatAgent::ApplyContextPolicy(TArray<FChatMessage>& MessageLog, const int32 InjectedTokens) const
+{
+	if (ContextPolicy == EChatContextPolicy::FullHistory)
+	{
+		return;
+	}
+
+	// System messages at the front of the log are never trimmed
+	int32 PinnedCount = 0;
+	while (PinnedCount < MessageLog.Num() && MessageLog[PinnedCount].Role == TEXT("system"))
+	{
+		++PinnedCount;
+	}
+
+	// A turn starts at every user message and runs until the next one
+	TArray<int32> TurnStarts;
+	for (int32 Index = PinnedCount; Index < MessageLog.Num(); ++Index)
+	{
+		if (TurnStarts.IsEmpty() || MessageLog[Index].Role == TEXT("user"))
+		{
+			TurnStarts.Add(Index);
+		}
+	}
+
+	// Dropping the oldest turn changes everything after the system messages, so with a stable prefix we cut down to half
+	// the limit in one go and the history that's left stays byte-identical (and cached) for the next several turns
+	const bool bTrimInBulk = PromptLayout == EChatPromptLayout::StablePrefix;
+
+	// Never drop the newest turn, it holds the message we're about to send
+	const int32 NumTurns = TurnStarts.Num();
+	int32 TurnsToDrop = 0;
+	switch (ContextPolicy)
+	{
+	case EChatContextPolicy::Stateless:
+		TurnsToDrop = NumTurns - 1;
+		break;
+	case EChatContextPolicy::SlidingWindow:
+		{
+			const int32 MaxTurns = FMath::Max(MaxContextTurns, 1);
+			if (NumTurns > MaxTurns)
 			{
-				// Extract the choices array from the JSON
-				if (const TArray<TSharedPtr<FJsonValue>>* ChoicesArray; JsonResponse->TryGetArrayField(TEXT("choices"), ChoicesArray))
-				{
-					if (ChoicesArray && ChoicesArray->Num() > 0)
-					{
-						// Get the first choice object
-						if (const TSharedPtr<FJsonValue> ChoiceObject = (*ChoicesArray)[0]; ChoiceObject.IsValid())
-						{
-							const TSharedPtr<FJsonObject> MessageObject = ChoiceObject->AsObject()->GetObjectField(TEXT("message"));
-
-							// Extract the message from the choice object
-							if (MessageObject.IsValid())
-							{
-								// Extract ChatGPT's response from inside the content field
-								const FString Reply = MessageObject->GetStringField(TEXT("content"));
-								UE_LOG(LogTemp, Log, TEXT("ChatGPT Response: %s"), *Reply);
-
-								OnResponseCallback(Reply);
-							}
-							else
-							{
-								UE_LOG(LogTemp, Error, TEXT("UChatAgent::SendMessage(): MessagesObject is invalid."));
-							}
-						}
-						else
-						{
-							UE_LOG(LogTemp, Error, TEXT("UChatAgent::SendMessage(): ChoiceObject is invalid."));
-						}
-					}
-					else
-					{
-						UE_LOG(LogTemp, Error, TEXT("UChatAgent::SendMessage(): ChoicesArray is invalid or empty."));
-					}
-				}
-				else
-				{
-					UE_LOG(LogTemp, Error, TEXT("UChatAgent::SendMessage(): failed to find the 'choices' array in the JSON response."));
-				}
+				TurnsToDrop = NumTurns - (bTrimInBulk ? FMath::Max(MaxTurns / 2, 1) : MaxTurns);
+			}
+		}
+		break;
+	case EChatContextPolicy::TokenBudget:
+		{
+			// The budget covers the whole request, including what gets written in next to the log
+			int32 TotalTokens = InjectedTokens;
+			for (const FChatMessage& Message : MessageLog)
+			{
+				TotalTokens += EstimateTokens(Message);
+			}
 
-				// Track token usage
-				if (const TSharedPtr<FJsonObject>* UsageObjectPtr; JsonResponse->TryGetObjectField(TEXT("usage"), UsageObjectPtr))
-				{
-					const TSharedPtr<FJsonObject> UsageObject = *UsageObjectPtr;
-					
-					// Access token usage fields within the usage object
-					int32 PromptTokens = UsageObject->GetIntegerField(TEXT("prompt_tokens"));
-					int32 CompletionTokens = UsageObject->GetIntegerField(TEXT("completion_tokens"));
-					int32 TotalTokens = UsageObject->GetIntegerField(TEXT("total_tokens"));
-
-					UE_LOG(LogTemp, Log, TEXT("Prompt Tokens: %d, Completion Tokens: %d, Total Tokens: %d"), PromptTokens, CompletionTokens, TotalTokens);
-				}
-				else
+			const int32 TargetTokens = TotalTokens > MaxContextTokens && bTrimInBulk ? MaxContextTokens / 2 : MaxContextTokens;
+			while (TotalTokens > TargetTokens && TurnsToDrop < NumTurns - 1)
+			{
+				for (int32 Index = TurnStarts[TurnsToDrop]; Index < TurnStarts[TurnsToDrop + 1]; ++Index)
 				{
-					UE_LOG(LogTemp, Error, TEXT("Failed to retrieve 'usage' field as an object."));
+					TotalTokens -= EstimateTokens(MessageLog[Index]);
 				}
+				++TurnsToDrop;
 			}
-		});
+		}
+		break;
+	default:
+		break;
+	}
+
+	if (TurnsToDrop <= 0)
+	{
+		return;
+	}
 
-	// Finally, send the request
-	HttpRequest->ProcessRequest();
+	const int32 NumToRemove = TurnStarts[TurnsToDrop] - PinnedCount;
+	MessageLog.RemoveAt(PinnedCount, NumToRemove);
+	UE_LOG(LogTemp, Verbose, TEXT("UChatAgent::ApplyContextPolicy(): %s dropped %d turn(s) (%d messages)."), *GetName(), TurnsToDrop, NumToRemove);
+}
+
+int32 UChatAgent::EstimateTokens(const FString& Text)
+{
+	return FChatTokenizer::Get().CountTokens(Text);
+}
+
+int32 UChatAgent::EstimateTokens(const FChatMessage& Message)
+{
+	return FChatTokenizer::Get().CountTokens(Message);
+}
+
+bool UChatAgent::LoadPromptRow(const FName& RowName, FString& OutPrompt) const
+{
+	// Every agent of every session reads the same rows, so they're only pulled out of the DT once
+	return FChatPromptLibrary::Get().GetPrompt(RowName, OutPrompt);
 }
 
 FString UChatAgent::BuildWrappedUserMessage(const FString& CurrentWorldStateJson, const FString& RulesResultJson, const FString& PlayerInput) const
 {
+	// The history form plus the snapshot, so when the message is collapsed later only its tail changes
+	if (PromptLayout == EChatPromptLayout::StablePrefix)
+	{
+		return BuildHistoryUserMessage(RulesResultJson, PlayerInput) + TEXT("\n\nWORLDSTATE:\n") + CurrentWorldStateJson;
+	}
+
 	// Wrap the message into a format that contains the world state AND the player's input
 	return FString::Printf(
 		TEXT("WORLDSTATE:\n%s\n\nRULESRESULT:\n%s\n\nPLAYERINPUT:\n%s"),
@@ -154,6 +1033,11 @@ FString UChatAgent::BuildWrappedUserMessage(const FString& CurrentWorldStateJson
 
 FString UChatAgent::BuildWrappedUserMessage(const FString& CurrentWorldStateJson, const FString& PlayerInput) const
 {
+	if (PromptLayout == EChatPromptLayout::StablePrefix)
+	{
+		return BuildHistoryUserMessage(PlayerInput) + TEXT("\n\nWORLDSTATE:\n") + CurrentWorldStateJson;
+	}
+
 	// Wrap the message into a format that contains the world state AND the player's input
 	return FString::Printf(
 		TEXT("WORLDSTATE:\n%s\n\nPLAYERINPUT:\n%s"),
@@ -161,3 +1045,40 @@ FString UChatAgent::BuildWrappedUserMessage(const FString& CurrentWorldStateJson
 		*PlayerInput
 	);
 }
+
+FString UChatAgent::BuildHistoryUserMessage(const FString& RulesResultJson, const FString& PlayerInput) const
+{
+	return FString::Printf(
+		TEXT("RULESRESULT:\n%s\n\nPLAYERINPUT:\n%s"),
+		*RulesResultJson,
+		*PlayerInput
+	);
+}
+
+FString UChatAgent::BuildHistoryUserMessage(const FString& PlayerInput) const
+{
+	return FString::Printf(TEXT("PLAYERINPUT:\n%s"), *PlayerInput);
+}
+
+void UChatAgent::AppendMessage(TArray<FChatMessage>& MessageLog, const FChatMessage& NewMessage)
+{
+	// Only the previous newest message can still be in its full form, but walk back until we hit a collapsed one to be safe
+	for (int32 Index = MessageLog.Num() - 1; Index >= 0; --Index)
+	{
+		FChatMessage& Message = MessageLog[Index];
+		if (Message.HistoryContent.IsEmpty())
+		{
+			if (Message.Role == TEXT("user"))
+			{
+				break;
+			}
+			continue;
+		}
+
+		Message.Content = MoveTemp(Message.HistoryContent);
+		Message.HistoryContent.Empty();
+		Message.EncodedJson.Reset();
+	}
+
+	MessageLog.Push(NewMessage);
+}
\ No newline at end of file
@@ -0,0 +1,465 @@
+#include "ChatCompletionParser.h"
+
+namespace
+{
+	/** Case-sensitive comparison of a raw (still escaped) JSON key against an ASCII literal. */
+	template <int32 N>
+	bool KeyIs(const FAnsiStringView Key, const ANSICHAR (&Literal)[N])
+	{
+		return Key.Len() == N - 1 && FMemory::Memcmp(Key.GetData(), Literal, N - 1) == 0;
+	}
+
+	/** Append a code point to a UTF-8 byte buffer. */
+	template <typename BufferType>
+	void AppendUtf8(BufferType& Out, uint32 CodePoint)
+	{
+		if (CodePoint < 0x80)
+		{
+			Out.Add(static_cast<ANSICHAR>(CodePoint));
+		}
+		else if (CodePoint < 0x800)
+		{
+			Out.Add(static_cast<ANSICHAR>(0xC0 | (CodePoint >> 6)));
+			Out.Add(static_cast<ANSICHAR>(0x80 | (CodePoint & 0x3F)));
+		}
+		else if (CodePoint < 0x10000)
+		{
+			Out.Add(static_cast<ANSICHAR>(0xE0 | (CodePoint >> 12)));
+			Out.Add(static_cast<ANSICHAR>(0x80 | ((CodePoint >> 6) & 0x3F)));
+			Out.Add(static_cast<ANSICHAR>(0x80 | (CodePoint & 0x3F)));
+		}
+		else
+		{
+			Out.Add(static_cast<ANSICHAR>(0xF0 | (CodePoint >> 18)));
+			Out.Add(static_cast<ANSICHAR>(0x80 | ((CodePoint >> 12) & 0x3F)));
+			Out.Add(static_cast<ANSICHAR>(0x80 | ((CodePoint >> 6) & 0x3F)));
+			Out.Add(static_cast<ANSICHAR>(0x80 | (CodePoint & 0x3F)));
+		}
+	}
+
+	/** Forward-only cursor over UTF-8 JSON. Values we don't ask for are skipped without being decoded. */
+	struct FJsonCursor
+	{
+		const uint8* Pos;
+		const uint8* End;
+
+		void SkipWhitespace()
+		{
+			while (Pos < End && (*Pos == ' ' || *Pos == '\n' || *Pos == '\r' || *Pos == '\t'))
+			{
+				++Pos;
+			}
+		}
+
+		bool Consume(const uint8 Char)
+		{
+			SkipWhitespace();
+			if (Pos < End && *Pos == Char)
+			{
+				++Pos;
+				return true;
+			}
+			return false;
+		}
+
+		bool ConsumeNull()
+		{
+			SkipWhitespace();
+			if (End - Pos >= 4 && FMemory::Memcmp(Pos, "null", 4) == 0)
+			{
+				Pos += 4;
+				return true;
+			}
+			return false;
+		}
+
+		/** Read a string's raw bytes (escapes left in place) without decoding it. */
+		bool ReadRawString(FAnsiStringView& OutRaw, bool& bOutHasEscapes)
+		{
+			if (!Consume('"'))
+			{
+				return false;
+			}
+
+			const uint8* Start = Pos;
+			bOutHasEscapes = false;
+			while (Pos < End)
+			{
+				if (*Pos == '\\')
+				{
+					bOutHasEscapes = true;
+					Pos += 2;
+					continue;
+				}
+				if (*Pos == '"')
+				{
+					OutRaw = FAnsiStringView(reinterpret_cast<const ANSICHAR*>(Start), static_cast<int32>(Pos - Start));
+					++Pos;
+					return true;
+				}
+				++Pos;
+			}
+			return false;
+		}
+
+		/** Read and decode a string value. */
+		bool ReadString(FString& OutString)
+		{
+			FAnsiStringView Raw;
+			bool bHasEscapes;
+			if (!ReadRawString(Raw, bHasEscapes))
+			{
+				return false;
+			}
+
+			// Nothing to unescape, transcode straight from the response bytes
+			if (!bHasEscapes)
+			{
+				const FUTF8ToTCHAR Converted(Raw.GetData(), Raw.Len());
+				OutString = FString(Converted.Length(), Converted.Get());
+				return true;
+			}
+
+			TArray<ANSICHAR, TInlineAllocator<1024>> Unescaped;
+			Unescaped.Reserve(Raw.Len());
+			for (int32 Index = 0; Index < Raw.Len(); ++Index)
+			{
+				const ANSICHAR Char = Raw[Index];
+				if (Char != '\\' || Index + 1 >= Raw.Len())
+				{
+					Unescaped.Add(Char);
+					continue;
+				}
+
+				const ANSICHAR Escaped = Raw[++Index];
+				switch (Escaped)
+				{
+				case 'n': Unescaped.Add('\n'); break;
+				case 'r': Unescaped.Add('\r'); break;
+				case 't': Unescaped.Add('\t'); break;
+				case 'b': Unescaped.Add('\b'); break;
+				case 'f': Unescaped.Add('\f'); break;
+				case 'u':
+					{
+						uint32 CodePoint = 0;
+						if (!ReadHex4(Raw, Index + 1, CodePoint))
+						{
+							return false;
+						}
+						Index += 4;
+
+						// Surrogate pairs come as two \u escapes
+						if (CodePoint >= 0xD800 && CodePoint <= 0xDBFF)
+						{
+							uint32 Low = 0;
+							if (Index + 2 < Raw.Len() && Raw[Index + 1] == '\\' && Raw[Index + 2] == 'u' && ReadHex4(Raw, Index + 3, Low) && Low >= 0xDC00 && Low <= 0xDFFF)
+							{
+								CodePoint = 0x10000 + ((CodePoint - 0xD800) << 10) + (Low - 0xDC00);
+								Index += 6;
+							}
+							else
+							{
+								CodePoint = 0xFFFD;
+							}
+						}
+						else if (CodePoint >= 0xDC00 && CodePoint <= 0xDFFF)
+						{
+							CodePoint = 0xFFFD;
+						}
+						AppendUtf8(Unescaped, CodePoint);
+					}
+					break;
+				default:
+					// \" \\ \/
+					Unescaped.Add(Escaped);
+					break;
+				}
+			}
+
+			const FUTF8ToTCHAR Converted(Unescaped.GetData(), Unescaped.Num());
+			OutString = FString(Converted.Length(), Converted.Get());
+			return true;
+		}
+
+		static bool ReadHex4(const FAnsiStringView Raw, const int32 Start, uint32& OutValue)
+		{
+			if (Start + 4 > Raw.Len())
+			{
+				return false;
+			}
+
+			OutValue = 0;
+			for (int32 Index = Start; Index < Start + 4; ++Index)
+			{
+				const ANSICHAR Char = Raw[Index];
+				uint32 Digit;
+				if (Char >= '0' && Char <= '9')
+				{
+					Digit = Char - '0';
+				}
+				else if (Char >= 'a' && Char <= 'f')
+				{
+					Digit = Char - 'a' + 10;
+				}
+				else if (Char >= 'A' && Char <= 'F')
+				{
+					Digit = Char - 'A' + 10;
+				}
+				else
+				{
+					return false;
+				}
+				OutValue = (OutValue << 4) | Digit;
+			}
+			return true;
+		}
+
+		/** Read an integer, ignoring any fraction or exponent. */
+		bool ReadInt(int32& OutValue)
+		{
+			SkipWhitespace();
+			const bool bNegative = Pos < End && *Pos == '-';
+			if (bNegative)
+			{
+				++Pos;
+			}
+
+			const uint8* DigitsStart = Pos;
+			int64 Value = 0;
+			while (Pos < End && *Pos >= '0' && *Pos <= '9')
+			{
+				Value = Value * 10 + (*Pos - '0');
+				++Pos;
+			}
+			if (Pos == DigitsStart)
+			{
+				return false;
+			}
+
+			while (Pos < End && (*Pos == '.' || *Pos == 'e' || *Pos == 'E' || *Pos == '+' || *Pos == '-' || (*Pos >= '0' && *Pos <= '9')))
+			{
+				++Pos;
+			}
+
+			OutValue = static_cast<int32>(FMath::Clamp<int64>(bNegative ? -Value : Value, MIN_int32, MAX_int32));
+			return true;
+		}
+
+		/** Skip over any value: strings, numbers, literals and whole objects/arrays. */
+		bool SkipValue()
+		{
+			SkipWhitespace();
+			if (Pos >= End)
+			{
+				return false;
+			}
+
+			if (*Pos == '"')
+			{
+				FAnsiStringView Raw;
+				bool bHasEscapes;
+				return ReadRawString(Raw, bHasEscapes);
+			}
+
+			if (*Pos == '{' || *Pos == '[')
+			{
+				// Containers only need bracket matching, with strings skipped so brackets inside them don't count
+				int32 Depth = 0;
+				while (Pos < End)
+				{
+					const uint8 Char = *Pos;
+					if (Char == '"')
+					{
+						FAnsiStringView Raw;
+						bool bHasEscapes;
+						if (!ReadRawString(Raw, bHasEscapes))
+						{
+							return false;
+						}
+						continue;
+					}
+
+					++Pos;
+					if (Char == '{' || Char == '[')
+					{
+						++Depth;
+					}
+					else if ((Char == '}' || Char == ']') && --Depth == 0)
+					{
+						return true;
+					}
+				}
+				return false;
+			}
+
+			// Number, true, false or null
+			const uint8* Start = Pos;
+			while (Pos < End && *Pos != ',' && *Pos != '}' && *Pos != ']' && *Pos != ' ' && *Pos != '\n' && *Pos != '\r' && *Pos != '\t')
+			{
+				++Pos;
+			}
+			return Pos > Start;
+		}
+
+		/** Walk an object's members, OnMember(Key) must consume the member's value. */
+		template <typename FunctorType>
+		bool ForEachMember(FunctorType&& OnMember)
+		{
+			if (!Consume('{'))
+			{
+				return false;
+			}
+			if (Consume('}'))
+			{
+				return true;
+			}
+
+			do
+			{
+				FAnsiStringView Key;
+				bool bHasEscapes;
+				if (!ReadRawString(Key, bHasEscapes) || !Consume(':') || !OnMember(Key))
+				{
+					return false;
+				}
+			}
+			while (Consume(','));
+
+			return Consume('}');
+		}
+
+		/** Walk an array's elements, OnElement(Index) must consume the element. */
+		template <typename FunctorType>
+		bool ForEachElement(FunctorType&& OnElement)
+		{
+			if (!Consume('['))
+			{
+				return false;
+			}
+			if (Consume(']'))
+			{
+				return true;
+			}
+
+			int32 Index = 0;
+			do
+			{
+				if (!OnElement(Index++))
+				{
+					return false;
+				}
+			}
+			while (Consume(','));
+
+			return Consume(']');
+		}
+	};
+
+	bool ParseUsage(FJsonCursor& Cursor, FChatCompletionUsage& OutUsage)
+	{
+		if (Cursor.ConsumeNull())
+		{
+			return true;
+		}
+
+		OutUsage.bValid = true;
+		return Cursor.ForEachMember([&](const FAnsiStringView Key)
+		{
+			if (KeyIs(Key, "prompt_tokens"))
+			{
+				return Cursor.ReadInt(OutUsage.PromptTokens);
+			}
+			if (KeyIs(Key, "completion_tokens"))
+			{
+				return Cursor.ReadInt(OutUsage.CompletionTokens);
+			}
+			if (KeyIs(Key, "total_tokens"))
+			{
+				return Cursor.ReadInt(OutUsage.TotalTokens);
+			}
+			if (KeyIs(Key, "prompt_tokens_details"))
+			{
+				if (Cursor.ConsumeNull())
+				{
+					return true;
+				}
+				return Cursor.ForEachMember([&](const FAnsiStringView DetailKey)
+				{
+					return KeyIs(DetailKey, "cached_tokens") ? Cursor.ReadInt(OutUsage.CachedTokens) : Cursor.SkipValue();
+				});
+			}
+			return Cursor.SkipValue();
+		});
+	}
+
+	/** Shared walk for completions and chunks, which differ only in whether the text sits under "message" or "delta". */
+	template <int32 N>
+	bool ParseBody(const uint8* Data, const int32 Len, const ANSICHAR (&MessageKey)[N], FChatCompletionResult& OutResult)
+	{
+		FJsonCursor Cursor{ Data, Data + Len };
+
+		return Cursor.ForEachMember([&](const FAnsiStringView Key)
+		{
+			if (KeyIs(Key, "choices"))
+			{
+				if (Cursor.ConsumeNull())
+				{
+					return true;
+				}
+
+				return Cursor.ForEachElement([&](const int32 ChoiceIndex)
+				{
+					// Only the first choice matters
+					if (ChoiceIndex > 0)
+					{
+						return Cursor.SkipValue();
+					}
+
+					return Cursor.ForEachMember([&](const FAnsiStringView ChoiceKey)
+					{
+						if (!KeyIs(ChoiceKey, MessageKey))
+						{
+							return Cursor.SkipValue();
+						}
+						if (Cursor.ConsumeNull())
+						{
+							return true;
+						}
+
+						return Cursor.ForEachMember([&](const FAnsiStringView MessageMemberKey)
+						{
+							if (!KeyIs(MessageMemberKey, "content"))
+							{
+								return Cursor.SkipValue();
+							}
+							if (Cursor.ConsumeNull())
+							{
+								return true;
+							}
+
+							OutResult.bHasContent = Cursor.ReadString(OutResult.Content);
+							return OutResult.bHasContent;
+						});
+					});
+				});
+			}
+
+			if (KeyIs(Key, "usage"))
+			{
+				return ParseUsage(Cursor, OutResult.Usage);
+			}
+
+			return Cursor.SkipValue();
+		});
+	}
+}
+
+bool FChatCompletionParser::ParseCompletion(const uint8* Data, const int32 Len, FChatCompletionResult& OutResult)
+{
+	return ParseBody(Data, Len, "message", OutResult);
+}
+
+bool FChatCompletionParser::ParseChunk(const uint8* Data, const int32 Len, FChatCompletionResult& OutResult)
+{
+	return ParseBody(Data, Len, "delta", OutResult);
+}
\ No newline at end of file
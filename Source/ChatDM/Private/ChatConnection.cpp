@@ -0,0 +1,132 @@
+#include "ChatConnection.h"
+
+#include "HAL/IConsoleManager.h"
+#include "HttpModule.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Interfaces/IHttpResponse.h"
+#include "Misc/CommandLine.h"
+
+namespace
+{
+	FAutoConsoleCommand ConnectionStatsCommand(
+		TEXT("ChatDM.Connection.Stats"),
+		TEXT("Logs how many agent requests were sent while the connection to the endpoint was likely still open (warm, a heuristic) and how long warm and cold requests took."),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			FChatConnection::Get().LogStats();
+		}));
+}
+
+FChatConnection& FChatConnection::Get()
+{
+	static FChatConnection Instance;
+	return Instance;
+}
+
+FChatConnection::FChatConnection()
+	: Endpoint(TEXT("https://api.openai.com/v1/chat/completions"))
+{
+	bEndpointFromCommandLine = FParse::Value(FCommandLine::Get(), TEXT("ChatDMEndpoint="), Endpoint);
+}
+
+void FChatConnection::SetEndpoint(const FString& InEndpoint)
+{
+	if (bEndpointFromCommandLine || InEndpoint.IsEmpty() || InEndpoint == Endpoint)
+	{
+		return;
+	}
+
+	// A different host means a different connection
+	Endpoint = InEndpoint;
+	LastContactTime = 0.0;
+}
+
+void FChatConnection::Prewarm()
+{
+	if (IsWarm())
+	{
+		return;
+	}
+
+	++Stats.Prewarms;
+	SendPing();
+}
+
+void FChatConnection::SetKeepAliveInterval(const float IntervalSeconds)
+{
+	KeepAliveIntervalSeconds = IntervalSeconds;
+
+	if (KeepAliveTickerHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(KeepAliveTickerHandle);
+		KeepAliveTickerHandle.Reset();
+	}
+	if (IntervalSeconds > 0.0f)
+	{
+		KeepAliveTickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FChatConnection::TickKeepAlive), IntervalSeconds);
+	}
+}
+
+bool FChatConnection::IsWarm() const
+{
+	return LastContactTime > 0.0 && FPlatformTime::Seconds() - LastContactTime < IdleTimeoutSeconds;
+}
+
+void FChatConnection::NoteRequestComplete(const bool bWasWarm, const double Seconds)
+{
+	LastContactTime = FPlatformTime::Seconds();
+
+	if (bWasWarm)
+	{
+		++Stats.WarmRequests;
+		Stats.WarmSeconds += Seconds;
+	}
+	else
+	{
+		++Stats.ColdRequests;
+		Stats.ColdSeconds += Seconds;
+	}
+}
+
+void FChatConnection::LogStats() const
+{
+	UE_LOG(LogTemp, Log, TEXT("FChatConnection: %s, %d warm (heuristic) requests (avg %.3fs), %d cold (heuristic) requests (avg %.3fs), %d prewarms, %d keep-alive pings."),
+		*Endpoint,
+		Stats.WarmRequests,
+		Stats.WarmRequests > 0 ? Stats.WarmSeconds / Stats.WarmRequests : 0.0,
+		Stats.ColdRequests,
+		Stats.ColdRequests > 0 ? Stats.ColdSeconds / Stats.ColdRequests : 0.0,
+		Stats.Prewarms,
+		Stats.KeepAlivePings);
+}
+
+void FChatConnection::SendPing()
+{
+	const TSharedRef<IHttpRequest> Request = FHttpModule::Get().CreateRequest();
+	Request->SetURL(Endpoint);
+	Request->SetVerb(TEXT("HEAD"));
+
+	const double StartTime = FPlatformTime::Seconds();
+	Request->OnProcessRequestComplete().BindLambda(
+		[StartTime](FHttpRequestPtr, const FHttpResponsePtr& Response, const bool bWasSuccessful)
+		{
+			// The status code doesn't matter (the endpoint only takes POST), only that the server answered
+			if (bWasSuccessful && Response.IsValid())
+			{
+				UE_LOG(LogTemp, Verbose, TEXT("FChatConnection: Ping answered with %d in %.3fs."), Response->GetResponseCode(), FPlatformTime::Seconds() - StartTime);
+				FChatConnection::Get().LastContactTime = FPlatformTime::Seconds();
+			}
+		});
+	Request->ProcessRequest();
+}
+
+bool FChatConnection::TickKeepAlive(float DeltaTime)
+{
+	// Real requests keep the connection alive on their own, only ping when things have gone quiet
+	if (FPlatformTime::Seconds() - LastContactTime >= KeepAliveIntervalSeconds)
+	{
+		++Stats.KeepAlivePings;
+		SendPing();
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "ChatCompletionParser.h"
+#include "ChatGPTManager.h"
+#include "ChatTokenizer.h"
+#include "Dom/JsonObject.h"
+#include "HAL/IConsoleManager.h"
+#include "Serialization/JsonSerializer.h"
+#include "WorldStateView.h"
+
+// Developer-only microbenchmarks, run from the console (e.g. "ChatDM.Bench.ResponseParser 5000").
+#if !UE_BUILD_SHIPPING
+
+namespace ChatDMBenchmarks
+{
+	/** A chat.completion body shaped like the API's, with ContentChars characters of narration in it. */
+	TArray<uint8> MakeCompletionBody(const int32 ContentChars)
+	{
+		// Narration with the usual suspects: quotes, newlines and some non-ASCII text that needs escaping or transcoding
+		const FString Sentence = TEXT("The goblin snarls, \\\"Mine!\\\" and lunges across the pedestal \\u2014 its blade glinting.\\n");
+		FString Content;
+		while (Content.Len() < ContentChars)
+		{
+			Content += Sentence;
+		}
+
+		const FString Body = FString::Printf(TEXT(
+			"{\"id\":\"chatcmpl-bench\",\"object\":\"chat.completion\",\"created\":1730000000,\"model\":\"gpt-4o-2024-08-06\","
+			"\"choices\":[{\"index\":0,\"message\":{\"role\":\"assistant\",\"content\":\"%s\",\"refusal\":null},\"logprobs\":null,\"finish_reason\":\"stop\"}],"
+			"\"usage\":{\"prompt_tokens\":1843,\"completion_tokens\":412,\"total_tokens\":2255,"
+			"\"prompt_tokens_details\":{\"cached_tokens\":1536,\"audio_tokens\":0},\"completion_tokens_details\":{\"reasoning_tokens\":0,\"audio_tokens\":0}},"
+			"\"system_fingerprint\":\"fp_bench\"}"), *Content);
+
+		const FTCHARToUTF8 Utf8(*Body);
+		return TArray<uint8>(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+	}
+
+	void RunResponseParserBenchmark(const TArray<FString>& Args)
+	{
+		const int32 Iterations = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 2000;
+		const int32 ContentChars = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 4000;
+		const TArray<uint8> Body = MakeCompletionBody(ContentChars);
+
+		// Both paths add to a checksum so neither can be optimized away
+		int64 DomChecksum = 0;
+		int64 PullChecksum = 0;
+
+		// The old path: GetContentAsString() copy, full DOM, then walk it for the two fields we need
+		const double DomStart = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		{
+			const FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Body.GetData()), Body.Num());
+			const FString BodyString(Converted.Length(), Converted.Get());
+
+			const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(BodyString);
+			TSharedPtr<FJsonObject> JsonResponse;
+			if (FJsonSerializer::Deserialize(Reader, JsonResponse) && JsonResponse.IsValid())
+			{
+				const TArray<TSharedPtr<FJsonValue>>& Choices = JsonResponse->GetArrayField(TEXT("choices"));
+				DomChecksum += Choices[0]->AsObject()->GetObjectField(TEXT("message"))->GetStringField(TEXT("content")).Len();
+				DomChecksum += JsonResponse->GetObjectField(TEXT("usage"))->GetIntegerField(TEXT("total_tokens"));
+			}
+		}
+		const double DomSeconds = FPlatformTime::Seconds() - DomStart;
+
+		// The new path: pull the fields straight out of the bytes
+		const double PullStart = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		{
+			FChatCompletionResult Result;
+			if (FChatCompletionParser::ParseCompletion(Body.GetData(), Body.Num(), Result))
+			{
+				PullChecksum += Result.Content.Len();
+				PullChecksum += Result.Usage.TotalTokens;
+			}
+		}
+		const double PullSeconds = FPlatformTime::Seconds() - PullStart;
+
+		UE_LOG(LogTemp, Display, TEXT("ChatDM.Bench.ResponseParser: %d iterations over a %d byte body. DOM: %.2f us/op, pull parser: %.2f us/op (%.1fx). Checksums %s."),
+			Iterations,
+			Body.Num(),
+			DomSeconds * 1e6 / Iterations,
+			PullSeconds * 1e6 / Iterations,
+			PullSeconds > 0.0 ? DomSeconds / PullSeconds : 0.0,
+			DomChecksum == PullChecksum ? TEXT("match") : TEXT("DIFFER"));
+	}
+
+	FAutoConsoleCommand ResponseParserCommand(
+		TEXT("ChatDM.Bench.ResponseParser"),
+		TEXT("Times the old DOM response path against FChatCompletionParser. Args: [Iterations=2000] [ContentChars=4000]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&RunResponseParserBenchmark));
+
+	/** Prompt text shaped like a narrator's history: player inputs, world state JSON and narration, at least TextChars long. */
+	FString MakePromptText(const int32 TextChars)
+	{
+		const FString WorldStateJson = FWorldStateView::ToJson(UChatGPTManager::MakeStartingWorldState(), FWorldStateViewSettings());
+		const FString Narration = TEXT("The goblin snarls, \"Mine!\" and lunges across the pedestal \u2014 its rusted blade glinting in the torchlight. You've got 3 heartbeats to act.\n");
+
+		FString Text;
+		for (int32 Turn = 0; Text.Len() < TextChars; ++Turn)
+		{
+			Text += FString::Printf(TEXT("PLAYERINPUT:\nI grab the key and back toward exit %d.\n\nWORLDSTATE:\n%s\n\n%s"), Turn, *WorldStateJson, *Narration);
+		}
+		return Text;
+	}
+
+	void RunTokenizerBenchmark(const TArray<FString>& Args)
+	{
+		const int32 Iterations = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 200;
+		const int32 TextChars = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 20000;
+
+		FChatTokenizer& Tokenizer = FChatTokenizer::Get();
+		if (!Tokenizer.HasVocabulary())
+		{
+			UE_LOG(LogTemp, Warning, TEXT("ChatDM.Bench.Tokenizer: No vocab file loaded, nothing to time."));
+			return;
+		}
+
+		const FString Text = MakePromptText(TextChars);
+
+		// Every piece split and merged, as for text never seen before
+		TArray<int32> Tokens;
+		int64 EncodeTokens = 0;
+		const double EncodeStart = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		{
+			Tokens.Reset();
+			Tokenizer.Encode(Text, Tokens);
+			EncodeTokens += Tokens.Num();
+		}
+		const double EncodeSeconds = FPlatformTime::Seconds() - EncodeStart;
+
+		// What a turn mostly sees: the history and world state repeat, so most pieces come out of the cache
+		int64 CountedTokens = 0;
+		const double CountStart = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		{
+			CountedTokens += Tokenizer.CountTokens(Text);
+		}
+		const double CountSeconds = FPlatformTime::Seconds() - CountStart;
+
+		UE_LOG(LogTemp, Display, TEXT("ChatDM.Bench.Tokenizer: %d iterations over %d chars = %d tokens (%.2f chars/token, four chars a token would say %d). Encode: %.2f M tokens/s, cached count: %.2f M tokens/s (%.1f us/op). Counts %s."),
+			Iterations,
+			Text.Len(),
+			Tokens.Num(),
+			Tokens.Num() > 0 ? static_cast<double>(Text.Len()) / Tokens.Num() : 0.0,
+			(Text.Len() + 3) / 4,
+			EncodeSeconds > 0.0 ? EncodeTokens / EncodeSeconds / 1e6 : 0.0,
+			CountSeconds > 0.0 ? CountedTokens / CountSeconds / 1e6 : 0.0,
+			CountSeconds * 1e6 / Iterations,
+			EncodeTokens == CountedTokens ? TEXT("match") : TEXT("DIFFER"));
+	}
+
+	FAutoConsoleCommand TokenizerCommand(
+		TEXT("ChatDM.Bench.Tokenizer"),
+		TEXT("Times FChatTokenizer's tokens/s, uncached and through its piece cache. Args: [Iterations=200] [TextChars=20000]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&RunTokenizerBenchmark));
+
+	/** A corridor of Rooms rooms, each joined to the next by a north/south exit, with EnemiesPerRoom enemies and two items in each. */
+	FWorldState MakeCorridorWorldState(const int32 Rooms, const int32 EnemiesPerRoom)
+	{
+		FWorldState State;
+		for (int32 RoomIndex = 0; RoomIndex < Rooms; ++RoomIndex)
+		{
+			FRoom& Room = State.Rooms.AddDefaulted_GetRef();
+			Room.RoomIndex = RoomIndex;
+			Room.Name = FString::Printf(TEXT("Guard Room %d"), RoomIndex);
+			Room.Description = TEXT("A low vaulted room with weapon racks along the walls and a brazier smoking in the corner.");
+			Room.Items = { TEXT("Rusty Key"), TEXT("Torch") };
+			if (RoomIndex > 0)
+			{
+				Room.Exits.Add(TEXT("South"));
+				Room.ExitRoomIndices.Add(RoomIndex - 1);
+			}
+			if (RoomIndex < Rooms - 1)
+			{
+				Room.Exits.Add(TEXT("North"));
+				Room.ExitRoomIndices.Add(RoomIndex + 1);
+			}
+
+			for (int32 EnemyIndex = 0; EnemyIndex < EnemiesPerRoom; ++EnemyIndex)
+			{
+				FEnemy& Enemy = Room.Enemies.AddDefaulted_GetRef();
+				Enemy.EnemyIndex = EnemyIndex;
+				Enemy.Name = *FString::Printf(TEXT("Goblin %d"), EnemyIndex);
+				Enemy.Health = 3;
+				Enemy.Status = TEXT("Idle");
+				Enemy.IntentOrGoal = TEXT("Guards the room and attacks anyone who takes an item.");
+			}
+		}
+		State.PlayerHeldItems = { TEXT("Longsword"), TEXT("Wooden Shield"), TEXT("Healing Potion") };
+		State.BuildIndexes();
+		return State;
+	}
+
+	void LogWorldStateSizes(const TCHAR* WorldName, const FWorldState& State)
+	{
+		FChatTokenizer& Tokenizer = FChatTokenizer::Get();
+		for (const EWorldStateScope Scope : { EWorldStateScope::FullWorld, EWorldStateScope::Neighborhood })
+		{
+			for (const EWorldStateFormat Format : { EWorldStateFormat::PrettyJson, EWorldStateFormat::MinifiedJson, EWorldStateFormat::Compact })
+			{
+				FWorldStateViewSettings Settings;
+				Settings.Scope = Scope;
+				Settings.Format = Format;
+				const FString Json = FWorldStateView::ToJson(State, Settings);
+
+				// BPE tokens when the vocab is there, otherwise the old four chars a token
+				UE_LOG(LogTemp, Display, TEXT("ChatDM.Bench.WorldState: %s, %s, %s: %d chars, %d tokens%s."),
+					WorldName,
+					*UEnum::GetDisplayValueAsText(Scope).ToString(),
+					*UEnum::GetDisplayValueAsText(Format).ToString(),
+					Json.Len(),
+					Tokenizer.HasVocabulary() ? Tokenizer.CountTokens(Json) : (Json.Len() + 3) / 4,
+					Tokenizer.HasVocabulary() ? TEXT("") : TEXT(" (at 4 chars/token, no vocab loaded)"));
+			}
+		}
+	}
+
+	void RunWorldStateBenchmark(const TArray<FString>& Args)
+	{
+		const int32 Rooms = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 10;
+		const int32 EnemiesPerRoom = Args.Num() > 1 ? FMath::Max(0, FCString::Atoi(*Args[1])) : 3;
+
+		LogWorldStateSizes(TEXT("starting world"), UChatGPTManager::MakeStartingWorldState());
+		LogWorldStateSizes(*FString::Printf(TEXT("%d rooms x %d enemies"), Rooms, EnemiesPerRoom), MakeCorridorWorldState(Rooms, EnemiesPerRoom));
+	}
+
+	FAutoConsoleCommand WorldStateCommand(
+		TEXT("ChatDM.Bench.WorldState"),
+		TEXT("Logs the size of the WORLDSTATE block in every format, for the whole world and a neighborhood, for the starting world and a generated one. Args: [Rooms=10] [EnemiesPerRoom=3]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&RunWorldStateBenchmark));
+}
+
+#endif
\ No newline at end of file
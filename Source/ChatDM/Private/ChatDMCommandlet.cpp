@@ -0,0 +1,273 @@
+#include "ChatDMCommandlet.h"
+
+#include "ChatConnection.h"
+#include "ChatGPTManager.h"
+#include "Containers/Ticker.h"
+#include "HttpManager.h"
+#include "HttpModule.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Interfaces/IHttpResponse.h"
+#include "Misc/FileHelper.h"
+
+#include <stdio.h>
+
+namespace
+{
+	/* Read one UTF-8 line from the stream, without its line break. Returns false at the end of the stream. */
+	bool ReadLine(FILE* Stream, FString& OutLine)
+	{
+		TArray<ANSICHAR> Line;
+		ANSICHAR Buffer[1024];
+		while (fgets(Buffer, UE_ARRAY_COUNT(Buffer), Stream))
+		{
+			Line.Append(Buffer, FCStringAnsi::Strlen(Buffer));
+			if (Line.Last() == '\n')
+			{
+				break;
+			}
+		}
+
+		if (Line.IsEmpty())
+		{
+			return false;
+		}
+
+		const FUTF8ToTCHAR Converted(Line.GetData(), Line.Num());
+		OutLine = FString(Converted.Length(), Converted.Get());
+		OutLine.TrimEndInline();
+		return true;
+	}
+
+	void WriteLine(const FString& Text)
+	{
+		fputs(TCHAR_TO_UTF8(*Text), stdout);
+		fputs("\n", stdout);
+		fflush(stdout);
+	}
+
+	bool IsPlayerInput(const FString& Line)
+	{
+		const FString Trimmed = Line.TrimStart();
+		return !Trimmed.IsEmpty() && !Trimmed.StartsWith(TEXT("#"));
+	}
+
+	/* On top of the request deadlines, for queueing, parsing and the turn's own bookkeeping */
+	constexpr float TurnTimeoutSlackSeconds = 30.0f;
+
+	/* Used for an agent whose retry policy sets no deadline */
+	constexpr float NoDeadlineTurnTimeoutSeconds = 300.0f;
+
+	/* Longest a single -ConnectionCheck request may take */
+	constexpr double ConnectionCheckTimeoutSeconds = 30.0;
+}
+
+UChatDMCommandlet::UChatDMCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = false;
+	ShowErrorCount = false;
+}
+
+int32 UChatDMCommandlet::Main(const FString& Params)
+{
+	int32 ConnectionCheckRequests = 5;
+	if (FParse::Value(*Params, TEXT("ConnectionCheck="), ConnectionCheckRequests) || FParse::Param(*Params, TEXT("ConnectionCheck")))
+	{
+		return RunConnectionCheck(FMath::Max(ConnectionCheckRequests, 2));
+	}
+
+	// Read the whole script up front so a bad path fails before we spend any requests
+	FString InputPath;
+	TArray<FString> ScriptLines;
+	const bool bFromScript = FParse::Value(*Params, TEXT("Input="), InputPath);
+	if (bFromScript && !FFileHelper::LoadFileToStringArray(ScriptLines, *InputPath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("UChatDMCommandlet::Main(): Failed to read input file %s"), *InputPath);
+		return 1;
+	}
+
+	ChatGptManager = NewObject<UChatGPTManager>(this);
+
+	FString PipelineName;
+	if (FParse::Value(*Params, TEXT("Pipeline="), PipelineName) && PipelineName == TEXT("Combined"))
+	{
+		ChatGptManager->Pipeline = EChatDMPipeline::Combined;
+	}
+	ChatGptManager->bSpeculativeNarration = FParse::Param(*Params, TEXT("Speculate"));
+
+	ChatGptManager->OnChatGptResponseReceived.AddDynamic(this, &UChatDMCommandlet::HandleResponse);
+
+	// Opening narration first, like the game does
+	ChatGptManager->Initialize();
+
+	if (!FParse::Value(*Params, TEXT("TurnTimeout="), TurnTimeoutSeconds) || TurnTimeoutSeconds <= 0.0f)
+	{
+		TurnTimeoutSeconds = GetDefaultTurnTimeout();
+	}
+	PumpUntilIdle();
+
+	int32 Turns = 0;
+	int32 NextScriptLine = 0;
+	FString Line;
+	while (!IsEngineExitRequested())
+	{
+		if (bFromScript)
+		{
+			if (!ScriptLines.IsValidIndex(NextScriptLine))
+			{
+				break;
+			}
+			Line = ScriptLines[NextScriptLine++];
+		}
+		else if (!ReadLine(stdin, Line))
+		{
+			break;
+		}
+
+		if (!IsPlayerInput(Line))
+		{
+			continue;
+		}
+
+		// Echo scripted input so the output reads as a transcript
+		if (bFromScript)
+		{
+			WriteLine(TEXT("> ") + Line);
+		}
+
+		ChatGptManager->SendAgentChatRequest(Line);
+		PumpUntilIdle();
+		++Turns;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("UChatDMCommandlet::Main(): Session ended after %d turns, %d timed out."), Turns, TimedOutTurns);
+	ChatGptManager->Deinitialize();
+	return TimedOutTurns > 0 ? 1 : 0;
+}
+
+float UChatDMCommandlet::GetDefaultTurnTimeout() const
+{
+	const auto GetDeadline = [](const UChatAgent* Agent)
+	{
+		return IsValid(Agent) && Agent->RetryPolicy.DeadlineSeconds > 0.0f ? Agent->RetryPolicy.DeadlineSeconds : NoDeadlineTurnTimeoutSeconds;
+	};
+
+	const float RequestsSeconds = ChatGptManager->Pipeline == EChatDMPipeline::Combined
+		? GetDeadline(ChatGptManager->CombinedAgent)
+		: GetDeadline(ChatGptManager->RulesAgent) + GetDeadline(ChatGptManager->NarratorAgent);
+	return RequestsSeconds + TurnTimeoutSlackSeconds;
+}
+
+bool UChatDMCommandlet::PumpUntilIdle()
+{
+	// Nothing else ticks in a commandlet: HTTP completions, agent timers and the keep-alive all need pumping by hand
+	const double StartTime = FPlatformTime::Seconds();
+	double LastTime = StartTime;
+	while (ChatGptManager->IsTurnInProgress() && !IsEngineExitRequested())
+	{
+		const double Now = FPlatformTime::Seconds();
+		if (Now - StartTime > TurnTimeoutSeconds)
+		{
+			// A turn that never ends would stall a scripted run forever, so give up on it and go on with the next line
+			UE_LOG(LogTemp, Error, TEXT("UChatDMCommandlet::PumpUntilIdle(): Turn still running after %.0fs, abandoning it."), TurnTimeoutSeconds);
+			ChatGptManager->AbandonTurn();
+			WriteLine(TEXT("[turn timed out]"));
+			WriteLine(TEXT(""));
+			++TimedOutTurns;
+			return false;
+		}
+
+		const float DeltaTime = static_cast<float>(Now - LastTime);
+		LastTime = Now;
+
+		FHttpModule::Get().GetHttpManager().Tick(DeltaTime);
+		FTSTicker::GetCoreTicker().Tick(DeltaTime);
+		FPlatformProcess::Sleep(0.005f);
+	}
+	return true;
+}
+
+int32 UChatDMCommandlet::RunConnectionCheck(const int32 Requests)
+{
+	FChatConnection& Connection = FChatConnection::Get();
+	UE_LOG(LogTemp, Display, TEXT("UChatDMCommandlet::RunConnectionCheck(): %d requests to %s."), Requests, *Connection.GetEndpoint());
+
+	bool bPassed = true;
+	double ColdSeconds = 0.0;
+	double WarmSeconds = 0.0;
+	for (int32 Index = 0; Index < Requests; ++Index)
+	{
+		// Judged before sending, exactly like an agent request is
+		const bool bWarm = Connection.IsWarm();
+		const bool bExpectWarm = Index > 0;
+
+		const TSharedRef<IHttpRequest> Request = FHttpModule::Get().CreateRequest();
+		Request->SetURL(Connection.GetEndpoint());
+		Request->SetVerb(TEXT("HEAD"));
+		Request->SetTimeout(ConnectionCheckTimeoutSeconds);
+
+		bool bDone = false;
+		bool bAnswered = false;
+		Request->OnProcessRequestComplete().BindLambda([&bDone, &bAnswered](FHttpRequestPtr, const FHttpResponsePtr& Response, const bool bWasSuccessful)
+		{
+			bAnswered = bWasSuccessful && Response.IsValid();
+			bDone = true;
+		});
+
+		const double StartTime = FPlatformTime::Seconds();
+		Request->ProcessRequest();
+		double LastTime = StartTime;
+		while (!bDone && !IsEngineExitRequested())
+		{
+			const double Now = FPlatformTime::Seconds();
+			FHttpModule::Get().GetHttpManager().Tick(static_cast<float>(Now - LastTime));
+			LastTime = Now;
+			FPlatformProcess::Sleep(0.001f);
+		}
+		const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+		if (!bAnswered)
+		{
+			// The callback points into this frame, so it mustn't outlive it
+			Request->OnProcessRequestComplete().Unbind();
+			Request->CancelRequest();
+			UE_LOG(LogTemp, Error, TEXT("UChatDMCommandlet::RunConnectionCheck(): Request %d got no response, is the stand-in running?"), Index);
+			return 1;
+		}
+		Connection.NoteRequestComplete(bWarm, Seconds);
+
+		UE_LOG(LogTemp, Display, TEXT("UChatDMCommandlet::RunConnectionCheck(): Request %d %s in %.1fms."), Index, bWarm ? TEXT("warm") : TEXT("cold"), Seconds * 1000.0);
+		if (bWarm != bExpectWarm)
+		{
+			UE_LOG(LogTemp, Error, TEXT("UChatDMCommandlet::RunConnectionCheck(): Request %d was guessed %s, expected %s."), Index, bWarm ? TEXT("warm") : TEXT("cold"), bExpectWarm ? TEXT("warm") : TEXT("cold"));
+			bPassed = false;
+		}
+		if (bExpectWarm)
+		{
+			WarmSeconds += Seconds;
+		}
+		else
+		{
+			ColdSeconds += Seconds;
+		}
+	}
+
+	// A reused connection skips the TCP and TLS handshakes, so even against localhost it should show
+	const double AverageWarmSeconds = WarmSeconds / (Requests - 1);
+	if (AverageWarmSeconds >= ColdSeconds)
+	{
+		UE_LOG(LogTemp, Error, TEXT("UChatDMCommandlet::RunConnectionCheck(): Warm requests averaged %.1fms against %.1fms cold, the connection wasn't reused."), AverageWarmSeconds * 1000.0, ColdSeconds * 1000.0);
+		bPassed = false;
+	}
+
+	Connection.LogStats();
+	return bPassed ? 0 : 1;
+}
+
+void UChatDMCommandlet::HandleResponse(const FString& Response, bool IsPlayer)
+{
+	WriteLine(Response);
+	WriteLine(TEXT(""));
+}
\ No newline at end of file
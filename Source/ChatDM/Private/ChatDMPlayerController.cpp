@@ -19,6 +19,10 @@ void AChatDMPlayerController::BeginPlay()
 
 	UE_LOG(LogTemp, Log, TEXT("AChatDMPlayerController::BeginPlay(): ChatGPTManager successfully created and initialized."));
 
+	// Relay the narration as it streams in, so the chat box doesn't sit empty until the whole reply is there
+	ChatGptManager->OnChatGptResponseChunkReceived.AddDynamic(this, &AChatDMPlayerController::HandleResponseChunk);
+	ChatGptManager->OnChatGptResponseReceived.AddDynamic(this, &AChatDMPlayerController::HandleResponse);
+
 	// Tell listeners the ChatGPTManager is created so they can bind to events
 	OnChatGptManagerCreated.Broadcast();
 
@@ -30,8 +34,35 @@ void AChatDMPlayerController::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
 	if (ChatGptManager)
 	{
+		ChatGptManager->OnChatGptResponseChunkReceived.RemoveAll(this);
+		ChatGptManager->OnChatGptResponseReceived.RemoveAll(this);
 		ChatGptManager->Deinitialize();
 	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AChatDMPlayerController::HandleResponseChunk(const FString& Chunk, bool bIsFirstChunk)
+{
+	// A first chunk starts a new reply, even if the last one never finished
+	if (bIsFirstChunk || !bNarrationStreaming)
+	{
+		StreamingNarration.Reset();
+		bIsFirstChunk = true;
+	}
+	bNarrationStreaming = true;
+	StreamingNarration += Chunk;
+
+	OnNarrationStreamUpdated.Broadcast(StreamingNarration, bIsFirstChunk);
+}
+
+void AChatDMPlayerController::HandleResponse(const FString& Response, bool IsPlayer)
+{
+	const bool bWasStreamed = bNarrationStreaming;
+	bNarrationStreaming = false;
+	StreamingNarration.Reset();
+
+	OnNarrationCompleted.Broadcast(Response, bWasStreamed);
 }
 
 void AChatDMPlayerController::SendChatDMRequest(const FString& PlayerPrompt, bool bIsInitialRequest) const
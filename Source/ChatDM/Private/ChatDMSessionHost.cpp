@@ -0,0 +1,200 @@
+#include "ChatDMSessionHost.h"
+
+#include "ChatConnection.h"
+#include "ChatGPTManager.h"
+#include "Engine/Engine.h"
+#include "HAL/IConsoleManager.h"
+
+namespace
+{
+	/* How often idle sessions are looked for */
+	constexpr float ReapIntervalSeconds = 10.0f;
+
+	FAutoConsoleCommand SessionStatsCommand(
+		TEXT("ChatDM.Sessions.Stats"),
+		TEXT("Logs how many ChatDM sessions are hosted in this process and how many were created, refused and timed out."),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			if (GEngine)
+			{
+				if (const UChatDMSessionHost* Host = GEngine->GetEngineSubsystem<UChatDMSessionHost>())
+				{
+					Host->LogStats();
+				}
+			}
+		}));
+}
+
+void UChatDMSessionHost::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	ReapTickerHandle = FTSTicker::GetCoreTicker().AddTicker(
+		FTickerDelegate::CreateUObject(this, &UChatDMSessionHost::TickReapIdleSessions), ReapIntervalSeconds);
+}
+
+void UChatDMSessionHost::Deinitialize()
+{
+	FTSTicker::GetCoreTicker().RemoveTicker(ReapTickerHandle);
+
+	for (const TPair<FGuid, FChatDMSession>& Session : Sessions)
+	{
+		if (IsValid(Session.Value.Manager))
+		{
+			Session.Value.Manager->DeinitializeAgents();
+		}
+	}
+	Sessions.Empty();
+
+	if (bConnectionConfigured)
+	{
+		FChatConnection::Get().SetKeepAliveInterval(0.0f);
+		LogStats();
+	}
+
+	Super::Deinitialize();
+}
+
+UChatGPTManager* UChatDMSessionHost::CreateSession(const FWorldState& StartingWorldState, FGuid& OutSessionId)
+{
+	if (Sessions.Num() >= MaxSessions)
+	{
+		++SessionsRefused;
+		UE_LOG(LogTemp, Warning, TEXT("UChatDMSessionHost::CreateSession(): Already hosting %d sessions, refusing a new one."), Sessions.Num());
+		return nullptr;
+	}
+
+	// Games running in this process all talk to the same endpoint, so only the first one needs to open the connection
+	if (!bConnectionConfigured)
+	{
+		ConfigureConnection();
+	}
+
+	UChatGPTManager* Manager = NewObject<UChatGPTManager>(this);
+	Manager->WorldState = StartingWorldState;
+	Manager->InitializeAgents();
+	ApplySessionBudget(*Manager);
+
+	OutSessionId = FGuid::NewGuid();
+	FChatDMSession& Session = Sessions.Add(OutSessionId);
+	Session.Manager = Manager;
+	Session.LastActiveTime = FPlatformTime::Seconds();
+	++SessionsCreated;
+
+	return Manager;
+}
+
+bool UChatDMSessionHost::StartSession(const FGuid& SessionId)
+{
+	FChatDMSession* Session = Sessions.Find(SessionId);
+	if (!Session || !IsValid(Session->Manager))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UChatDMSessionHost::StartSession(): No session %s."), *SessionId.ToString());
+		return false;
+	}
+
+	Session->LastActiveTime = FPlatformTime::Seconds();
+	Session->Manager->SendInitialChatRequest();
+	return true;
+}
+
+bool UChatDMSessionHost::SubmitInput(const FGuid& SessionId, const FString& PlayerInput)
+{
+	FChatDMSession* Session = Sessions.Find(SessionId);
+	if (!Session || !IsValid(Session->Manager))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UChatDMSessionHost::SubmitInput(): No session %s."), *SessionId.ToString());
+		return false;
+	}
+
+	Session->LastActiveTime = FPlatformTime::Seconds();
+	Session->Manager->SendAgentChatRequest(PlayerInput);
+	return true;
+}
+
+void UChatDMSessionHost::DestroySession(const FGuid& SessionId)
+{
+	FChatDMSession Session;
+	if (!Sessions.RemoveAndCopyValue(SessionId, Session))
+	{
+		return;
+	}
+
+	if (IsValid(Session.Manager))
+	{
+		Session.Manager->DeinitializeAgents();
+	}
+}
+
+UChatGPTManager* UChatDMSessionHost::FindSession(const FGuid& SessionId) const
+{
+	const FChatDMSession* Session = Sessions.Find(SessionId);
+	return Session ? Session->Manager : nullptr;
+}
+
+void UChatDMSessionHost::LogStats() const
+{
+	UE_LOG(LogTemp, Log, TEXT("ChatDM sessions: %d hosted (max %d), %d created, %d refused, %d timed out."),
+		Sessions.Num(), MaxSessions, SessionsCreated, SessionsRefused, SessionsTimedOut);
+}
+
+void UChatDMSessionHost::ConfigureConnection()
+{
+	const UChatGPTManager* Defaults = GetDefault<UChatGPTManager>();
+
+	FChatConnection& Connection = FChatConnection::Get();
+	Connection.SetEndpoint(Defaults->EndpointUrl);
+	Connection.Prewarm();
+	Connection.SetKeepAliveInterval(Defaults->KeepAliveIntervalSeconds);
+
+	bConnectionConfigured = true;
+}
+
+void UChatDMSessionHost::ApplySessionBudget(UChatGPTManager& Manager) const
+{
+	if (SessionMaxContextTokens <= 0)
+	{
+		return;
+	}
+
+	for (UChatAgent* Agent : TArray<UChatAgent*>{ Manager.RulesAgent, Manager.NarratorAgent, Manager.CombinedAgent })
+	{
+		// Stateless agents never keep more than the newest turn, everything else gets trimmed to the budget
+		if (!IsValid(Agent) || Agent->ContextPolicy == EChatContextPolicy::Stateless)
+		{
+			continue;
+		}
+
+		Agent->MaxContextTokens = Agent->ContextPolicy == EChatContextPolicy::TokenBudget
+			? FMath::Min(Agent->MaxContextTokens, SessionMaxContextTokens)
+			: SessionMaxContextTokens;
+		Agent->ContextPolicy = EChatContextPolicy::TokenBudget;
+	}
+}
+
+bool UChatDMSessionHost::TickReapIdleSessions(float DeltaTime)
+{
+	if (SessionIdleTimeoutSeconds <= 0.0f)
+	{
+		return true;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	TArray<FGuid> IdleSessions;
+	for (const TPair<FGuid, FChatDMSession>& Session : Sessions)
+	{
+		if (Now - Session.Value.LastActiveTime > SessionIdleTimeoutSeconds)
+		{
+			IdleSessions.Add(Session.Key);
+		}
+	}
+
+	for (const FGuid& SessionId : IdleSessions)
+	{
+		UE_LOG(LogTemp, Log, TEXT("UChatDMSessionHost::TickReapIdleSessions(): Closing idle session %s."), *SessionId.ToString());
+		DestroySession(SessionId);
+		++SessionsTimedOut;
+	}
+
+	return true;
+}
\ No newline at end of file
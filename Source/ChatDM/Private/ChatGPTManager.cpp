@@ -1,19 +1,30 @@
 #include "ChatGPTManager.h"
 
+#include "ChatConnection.h"
 #include "ChatPromptRow.h"
+#include "CombinedAgent.h"
 #include "Enemy.h"
 #include "HttpModule.h"
 #include "JsonObjectConverter.h"
+#include "LocalRulesEvaluator.h"
 #include "Interfaces/IHttpRequest.h"
 #include "Interfaces/IHttpResponse.h"
 #include "NarratorAgent.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
 #include "RulesAgent.h"
 #include "RulesUpdate.h"
+#include "WorldStateView.h"
 
 void UChatGPTManager::Initialize()
 {
 	UE_LOG(LogTemp, Log, TEXT("ChatGPTManager initialized."));
 
+	// Start the DNS/TCP/TLS handshake now so it overlaps with setting up the agents instead of delaying the first turn
+	FChatConnection& Connection = FChatConnection::Get();
+	Connection.SetEndpoint(EndpointUrl);
+	Connection.Prewarm();
+	Connection.SetKeepAliveInterval(KeepAliveIntervalSeconds);
+
 	InitializeAgents();
 
 	SendInitialChatRequest();
@@ -28,7 +39,30 @@ void UChatGPTManager::InitializeAgents()
 
 	NarratorAgent = NewObject<UNarratorAgent>(this, UNarratorAgent::StaticClass(), TEXT("NarratorAgent"));
 	NarratorAgent->Initialize(TEXT(""));
-	
+
+	CombinedAgent = NewObject<UCombinedAgent>(this, UCombinedAgent::StaticClass(), TEXT("CombinedAgent"));
+	CombinedAgent->Initialize(TEXT(""));
+
+	// Any agent giving up ends the turn, otherwise the turn queue would wait forever
+	RulesAgent->OnRequestFailed.AddDynamic(this, &UChatGPTManager::HandleAgentRequestFailed);
+	NarratorAgent->OnRequestFailed.AddDynamic(this, &UChatGPTManager::HandleAgentRequestFailed);
+	CombinedAgent->OnRequestFailed.AddDynamic(this, &UChatGPTManager::HandleAgentRequestFailed);
+
+	// Whoever created us may have handed us a world to run already
+	if (WorldState.Rooms.IsEmpty())
+	{
+		WorldState = MakeStartingWorldState();
+	}
+	WorldState.BuildIndexes();
+
+	// Rules updates never touch the rooms' names, descriptions or exits, so the agents only need telling once
+	RulesAgent->SetDungeon(WorldState);
+	NarratorAgent->SetDungeon(WorldState);
+	CombinedAgent->SetDungeon(WorldState);
+}
+
+FWorldState UChatGPTManager::MakeStartingWorldState()
+{
 	FEnemy Goblin;
 	Goblin.EnemyIndex = 0;
 	Goblin.Name = TEXT("Goblin");
@@ -43,36 +77,272 @@ void UChatGPTManager::InitializeAgents()
 	StartingRoom.Exits.Add(TEXT("North"));
 	StartingRoom.Items.Add(TEXT("Key"));
 	StartingRoom.Enemies.Add(Goblin);
-	WorldState.Rooms.Add(StartingRoom);
 
-	WorldState.CurrentRoomIndex = 0;
-	WorldState.PlayerHeldItems.Add(TEXT("Longsword"));
-	WorldState.PlayerHeldItems.Add(TEXT("Wooden Shield"));
-	WorldState.PlayerHeldItems.Add(TEXT("Healing Potion"));
+	FWorldState StartingState;
+	StartingState.Rooms.Add(StartingRoom);
+
+	StartingState.CurrentRoomIndex = 0;
+	StartingState.PlayerHeldItems.Add(TEXT("Longsword"));
+	StartingState.PlayerHeldItems.Add(TEXT("Wooden Shield"));
+	StartingState.PlayerHeldItems.Add(TEXT("Healing Potion"));
+	return StartingState;
 }
 
 void UChatGPTManager::Deinitialize()
 {
-	RulesAgent->OnRulesResultReady.RemoveAll(this);
+	FChatConnection::Get().SetKeepAliveInterval(0.0f);
+	FChatConnection::Get().LogStats();
+
+	DeinitializeAgents();
+}
+
+void UChatGPTManager::DeinitializeAgents()
+{
+	// Nothing should answer into a manager that's going away, or spend tokens doing it
+	QueuedInputs.Reset();
+	TurnPhase = EChatDMTurnPhase::Idle;
+	for (UChatAgent* Agent : TArray<UChatAgent*>{ RulesAgent, NarratorAgent, CombinedAgent })
+	{
+		if (IsValid(Agent))
+		{
+			Agent->CancelRequests();
+			Agent->OnRequestFailed.RemoveAll(this);
+		}
+	}
+
+	if (IsValid(RulesAgent))
+	{
+		RulesAgent->OnRulesResultReady.RemoveAll(this);
+	}
+	if (IsValid(NarratorAgent))
+	{
+		NarratorAgent->OnNarratorResultReady.RemoveAll(this);
+		NarratorAgent->OnNarratorChunkReceived.RemoveAll(this);
+	}
+	if (IsValid(CombinedAgent))
+	{
+		CombinedAgent->OnCombinedResultReady.RemoveAll(this);
+	}
 }
 
 void UChatGPTManager::SendInitialChatRequest()
 {
-	// Send a request to ChatGPT to open the game with narration.
-	ExecuteNarratorAgent(TEXT(""));
+	// Send a request to ChatGPT to open the game with narration. Input sent before it arrives waits for it.
+	BeginTurnMetrics();
+	TurnPhase = EChatDMTurnPhase::Narrating;
+	ExecuteNarratorAgent(TEXT(""), TEXT("N/A"), true);
 }
 
 void UChatGPTManager::SendAgentChatRequest(const FString& PlayerInput)
 {
+	switch (TurnPhase)
+	{
+	case EChatDMTurnPhase::Idle:
+		StartTurn(PlayerInput);
+		break;
+
+	case EChatDMTurnPhase::Judging:
+		{
+			// Nothing has touched the world yet, so fold the new input into the pending turn and judge them together
+			UE_LOG(LogTemp, Log, TEXT("UChatGPTManager::SendAgentChatRequest(): Restarting the turn being judged with the new input coalesced into it."));
+			CancelJudgingRequests();
+			const FString CoalescedInput = ActiveTurnInput + TEXT("\n") + PlayerInput;
+			StartTurn(CoalescedInput);
+		}
+		break;
+
+	case EChatDMTurnPhase::Narrating:
+		// The world has already changed for the current input, this one needs a turn of its own
+		if (QueuedInputs.Num() >= MaxQueuedInputs)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("UChatGPTManager::SendAgentChatRequest(): %d inputs already waiting, dropping '%s'."), QueuedInputs.Num(), *PlayerInput);
+			break;
+		}
+		QueuedInputs.Add(PlayerInput);
+		break;
+	}
+}
+
+void UChatGPTManager::BeginTurnMetrics()
+{
+	CurrentTurnMetrics = FChatTurnMetrics();
+	TurnStartTime = FPlatformTime::Seconds();
+}
+
+void UChatGPTManager::StartTurn(const FString& PlayerInput)
+{
+	// A turn restarted with more input keeps timing from the first input, that's when the player started waiting
+	if (TurnPhase == EChatDMTurnPhase::Idle)
+	{
+		BeginTurnMetrics();
+	}
+	TurnPhase = EChatDMTurnPhase::Judging;
+	ActiveTurnInput = PlayerInput;
+
+	// Single round trip: one request returns both the rules result and the narration.
+	if (Pipeline == EChatDMPipeline::Combined)
+	{
+		ExecuteCombinedAgent(PlayerInput);
+		return;
+	}
+
+	// Trivial actions don't need a Rules Agent round trip, go straight to the narrator with the local verdict.
+	FRulesUpdate LocalRulesUpdate;
+	if (bLocalRulesFastPath && FLocalRulesEvaluator::TryEvaluate(PlayerInput, WorldState, LocalRulesUpdate))
+	{
+		++LocalRulesTurns;
+		UE_LOG(LogTemp, Log, TEXT("UChatGPTManager::SendAgentChatRequest(): Rules judged locally (local=%d, remote=%d)."), LocalRulesTurns, RemoteRulesTurns);
+
+		FString LocalRulesResultJson;
+		FJsonObjectConverter::UStructToJsonObjectString(LocalRulesUpdate, LocalRulesResultJson);
+		ApplyRulesResult(LocalRulesUpdate, LocalRulesResultJson, PlayerInput);
+		return;
+	}
+	++RemoteRulesTurns;
+
+	// Optionally get the narrator going on a guessed outcome so it overlaps with the Rules Agent.
+	if (bSpeculativeNarration)
+	{
+		StartSpeculativeNarration(PlayerInput);
+	}
+
 	// The agent chain starts off with the Rules Agent who needs to decide if the player's action can even happen.
 	ExecuteRulesAgent(PlayerInput);
 }
 
+void UChatGPTManager::FinishTurn()
+{
+	// Tokens are summed from the agents so retries, hedges and summaries are counted too
+	TokenUsage = FChatTokenUsage();
+	for (const UChatAgent* Agent : TArray<UChatAgent*>{ RulesAgent, NarratorAgent, CombinedAgent })
+	{
+		if (IsValid(Agent))
+		{
+			TokenUsage += Agent->TokenUsage;
+		}
+	}
+
+	CurrentTurnMetrics.TotalSeconds = FPlatformTime::Seconds() - TurnStartTime;
+	LastTurnMetrics = MoveTemp(CurrentTurnMetrics);
+	FChatMetrics::ReportTurn(LastTurnMetrics, TokenUsage);
+
+	TurnPhase = EChatDMTurnPhase::Idle;
+	ActiveTurnInput.Reset();
+
+	if (!QueuedInputs.IsEmpty())
+	{
+		const FString CoalescedInput = FString::Join(QueuedInputs, TEXT("\n"));
+		QueuedInputs.Reset();
+		StartTurn(CoalescedInput);
+	}
+}
+
+void UChatGPTManager::AbandonTurn()
+{
+	if (TurnPhase == EChatDMTurnPhase::Idle)
+	{
+		QueuedInputs.Reset();
+		return;
+	}
+
+	UE_LOG(LogTemp, Warning, TEXT("UChatGPTManager::AbandonTurn(): Abandoning the turn for '%s' and %d queued input(s)."), *ActiveTurnInput, QueuedInputs.Num());
+
+	QueuedInputs.Reset();
+	for (UChatAgent* Agent : TArray<UChatAgent*>{ RulesAgent, NarratorAgent, CombinedAgent })
+	{
+		if (IsValid(Agent))
+		{
+			Agent->CancelRequests();
+		}
+	}
+	FinishTurn();
+}
+
+void UChatGPTManager::CancelJudgingRequests()
+{
+	if (IsValid(RulesAgent))
+	{
+		RulesAgent->CancelRequests();
+	}
+	if (IsValid(CombinedAgent))
+	{
+		CombinedAgent->CancelRequests();
+	}
+	if (IsValid(NarratorAgent))
+	{
+		NarratorAgent->CancelSpeculation();
+	}
+}
+
+void UChatGPTManager::HandleAgentRequestFailed(const FString& PlayerInput)
+{
+	if (TurnPhase == EChatDMTurnPhase::Idle)
+	{
+		return;
+	}
+
+	UE_LOG(LogTemp, Error, TEXT("UChatGPTManager::HandleAgentRequestFailed(): Turn for '%s' failed."), *PlayerInput);
+
+	// A rules failure leaves a speculative narration with nothing to confirm it
+	if (TurnPhase == EChatDMTurnPhase::Judging)
+	{
+		CancelJudgingRequests();
+	}
+
+	OnChatGptResponseReceived.Broadcast(TEXT("The Dungeon Master lost their train of thought. Please try that again."), false);
+	FinishTurn();
+}
+
+void UChatGPTManager::StartSpeculativeNarration(const FString& PlayerInput)
+{
+	if (!IsValid(NarratorAgent))
+	{
+		return;
+	}
+
+	FRulesUpdate Prediction;
+	if (!PredictRulesUpdate(PlayerInput, Prediction))
+	{
+		return;
+	}
+
+	// A committed speculation is delivered through the same handlers as a normal narration.
+	BindNarratorAgent();
+
+	// Narrate against the world as it would look if the prediction holds.
+	FWorldState PredictedState = WorldState;
+	ApplyRulesUpdate(PredictedState, Prediction);
+	SpeculatedWorldStateJson = WorldStateToJson(PredictedState);
+	SpeculatedRulesUpdate = Prediction;
+
+	FString PredictedRulesResultJson;
+	FJsonObjectConverter::UStructToJsonObjectString(Prediction, PredictedRulesResultJson);
+
+	NarratorAgent->SendSpeculativeMessage(PlayerInput, WorldStateToJson(PredictedState, NarratorAgent), PredictedRulesResultJson);
+}
+
+bool UChatGPTManager::PredictRulesUpdate(const FString& PlayerInput, FRulesUpdate& OutPrediction) const
+{
+	if (PlayerInput.TrimStartAndEnd().IsEmpty())
+	{
+		return false;
+	}
+
+	// Most turns (looking around, talking, failed attempts) don't change the world,
+	// so the cheapest useful guess is "the action goes through and nothing changes".
+	OutPrediction = FRulesUpdate();
+	OutPrediction.bSuccess = true;
+	OutPrediction.StateChanges.CurrentRoomIndex = WorldState.CurrentRoomIndex;
+	OutPrediction.StateChanges.bHasCurrentRoomIndex = true;
+	return true;
+}
+
 void UChatGPTManager::ExecuteRulesAgent(const FString& PlayerInput)
 {
 	if (!IsValid(RulesAgent))
 	{
 		UE_LOG(LogTemp, Error, TEXT("UChatGPTManager::SendAgenticChatRequest(): Rules agent is invalid."));
+		FinishTurn();
 		return;
 	}
 
@@ -83,38 +353,116 @@ void UChatGPTManager::ExecuteRulesAgent(const FString& PlayerInput)
 	}
 
 	// Tell the RulesAgent to send its request.
-	const FString WorldStateJSON = WorldStateToJson(WorldState);
+	const FString WorldStateJSON = WorldStateToJson(WorldState, RulesAgent);
 	RulesAgent->SendMessage(PlayerInput, *WorldStateJSON);
 }
 
+void UChatGPTManager::ExecuteCombinedAgent(const FString& PlayerInput)
+{
+	if (!IsValid(CombinedAgent))
+	{
+		UE_LOG(LogTemp, Error, TEXT("UChatGPTManager::ExecuteCombinedAgent(): Combined agent is invalid."));
+		FinishTurn();
+		return;
+	}
+
+	// Bind so we can respond to the CombinedAgent completing its request and response processing.
+	if (!CombinedAgent->OnCombinedResultReady.IsAlreadyBound(this, &UChatGPTManager::HandleCombinedResult))
+	{
+		CombinedAgent->OnCombinedResultReady.AddDynamic(this, &UChatGPTManager::HandleCombinedResult);
+	}
+
+	const FString WorldStateJSON = WorldStateToJson(WorldState, CombinedAgent);
+	CombinedAgent->SendMessage(PlayerInput, WorldStateJSON);
+}
+
+void UChatGPTManager::HandleCombinedResult(const FRulesUpdate& RulesWorldStateUpdate, const FString& RulesResultJson, const FString& Narration, const FString& PlayerInput)
+{
+	if (TurnPhase != EChatDMTurnPhase::Judging)
+	{
+		return;
+	}
+
+	CurrentTurnMetrics.Requests.Add(CombinedAgent->LastRequestMetrics);
+
+	// Same state changes the agent chain would make, but the narration is already here so there's no second call.
+	ApplyTurnRulesUpdate(RulesWorldStateUpdate);
+	TurnPhase = EChatDMTurnPhase::Narrating;
+	DeliverNarration(Narration);
+}
+
 void UChatGPTManager::HandleRulesResult(const FRulesUpdate& RulesWorldStateUpdate, const FString& RulesResultJson, const FString& PlayerInput)
 {
-	// Update room information (items, enemies, etc.).
-	if (!RulesWorldStateUpdate.StateChanges.Rooms.IsEmpty())
+	// A verdict for a turn that was superseded or abandoned must not touch the world
+	if (TurnPhase != EChatDMTurnPhase::Judging)
 	{
-		for (const auto& RoomDiff : RulesWorldStateUpdate.StateChanges.Rooms)
+		return;
+	}
+
+	CurrentTurnMetrics.Requests.Add(RulesAgent->LastRequestMetrics);
+	ApplyRulesResult(RulesWorldStateUpdate, RulesResultJson, PlayerInput);
+}
+
+void UChatGPTManager::ApplyRulesResult(const FRulesUpdate& RulesWorldStateUpdate, const FString& RulesResultJson, const FString& PlayerInput)
+{
+	ApplyTurnRulesUpdate(RulesWorldStateUpdate);
+	TurnPhase = EChatDMTurnPhase::Narrating;
+
+	// If the narrator already started on a guess, keep it when the guess matches the real outcome.
+	// The reason and the picked up items are narrated too, so a verdict that adds either is a miss.
+	if (IsValid(NarratorAgent) && NarratorAgent->HasSpeculation())
+	{
+		const bool bSameReason = RulesWorldStateUpdate.Reason.IsEmpty() || RulesWorldStateUpdate.Reason == SpeculatedRulesUpdate.Reason;
+		const bool bSameItems = RulesWorldStateUpdate.ItemsPickedUp.IsEmpty() || RulesWorldStateUpdate.ItemsPickedUp == SpeculatedRulesUpdate.ItemsPickedUp;
+		if (RulesWorldStateUpdate.bSuccess == SpeculatedRulesUpdate.bSuccess && bSameReason && bSameItems
+			&& WorldStateToJson(WorldState) == SpeculatedWorldStateJson)
 		{
-			if (!WorldState.Rooms.IsValidIndex(RoomDiff.RoomIndex))
-			{
-				continue;
-			}
-			
-			FRoom& RoomToUpdate = WorldState.Rooms[RoomDiff.RoomIndex];
+			++SpeculationHits;
+			UE_LOG(LogTemp, Log, TEXT("UChatGPTManager::ApplyRulesResult(): Speculative narration committed (hits=%d, misses=%d)."), SpeculationHits, SpeculationMisses);
+			NarratorAgent->CommitSpeculation(RulesResultJson);
+			return;
+		}
 
-			// Replace all items with the diff's items
-			if (RoomDiff.Items != RoomToUpdate.Items)
-			{
-				RoomToUpdate.Items = RoomDiff.Items;
-			}
+		++SpeculationMisses;
+		UE_LOG(LogTemp, Log, TEXT("UChatGPTManager::ApplyRulesResult(): Speculative narration missed, re-issuing (hits=%d, misses=%d)."), SpeculationHits, SpeculationMisses);
+		NarratorAgent->CancelSpeculation();
+	}
+
+	ExecuteNarratorAgent(PlayerInput, RulesResultJson);
+}
+
+void UChatGPTManager::ApplyTurnRulesUpdate(const FRulesUpdate& RulesWorldStateUpdate)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(ChatDM_ApplyRulesUpdate);
 
-			// Replace enemies fully, match on name
-			for (const auto& EnemyDiff : RoomDiff.Enemies)
+	const double ApplyStartTime = FPlatformTime::Seconds();
+	ApplyRulesUpdate(WorldState, RulesWorldStateUpdate);
+	CurrentTurnMetrics.StateApplySeconds += FPlatformTime::Seconds() - ApplyStartTime;
+}
+
+void UChatGPTManager::ApplyRulesUpdate(FWorldState& State, const FRulesUpdate& RulesWorldStateUpdate)
+{
+	// Update room information (items, enemies, etc.). Rooms and enemies are looked up through the world's indexes,
+	// so each change costs the same however many rooms and enemies there are.
+	for (const FRoomUpdate& RoomDiff : RulesWorldStateUpdate.StateChanges.Rooms)
+	{
+		FRoom* RoomToUpdate = State.FindRoom(RoomDiff.RoomIndex);
+		if (!RoomToUpdate)
+		{
+			continue;
+		}
+
+		// Replace all items with the diff's items
+		RoomToUpdate->Items = RoomDiff.Items;
+
+		// Update enemies by name. A name that was never interned can't belong to any enemy.
+		for (const FEnemyUpdate& EnemyDiff : RoomDiff.Enemies)
+		{
+			const FName EnemyName(*EnemyDiff.Name, FNAME_Find);
+			if (FEnemy* EnemyToUpdate = EnemyName.IsNone() ? nullptr : RoomToUpdate->FindEnemy(EnemyName))
 			{
-				if (FEnemy* EnemyToUpdate = RoomToUpdate.Enemies.FindByPredicate([&](const FEnemy& E) { return E.Name == EnemyDiff.Name; }))
-				{
-					EnemyToUpdate->Health = EnemyDiff.Health;
-					EnemyToUpdate->Status = EnemyDiff.Status;
-				}
+				EnemyToUpdate->Health = EnemyDiff.Health;
+				EnemyToUpdate->Status = EnemyDiff.Status;
 			}
 		}
 	}
@@ -122,16 +470,14 @@ void UChatGPTManager::HandleRulesResult(const FRulesUpdate& RulesWorldStateUpdat
 	// Update player held items when it changes.
 	if (!RulesWorldStateUpdate.StateChanges.PlayerHeldItems.IsEmpty())
 	{
-		WorldState.PlayerHeldItems = RulesWorldStateUpdate.StateChanges.PlayerHeldItems;
+		State.PlayerHeldItems = RulesWorldStateUpdate.StateChanges.PlayerHeldItems;
 	}
 
-	// Update the current room index if we changed rooms.
-	if (RulesWorldStateUpdate.StateChanges.CurrentRoomIndex != WorldState.CurrentRoomIndex)
+	// Update the current room index if we changed rooms. An update that doesn't say leaves the player where they are.
+	if (RulesWorldStateUpdate.StateChanges.bHasCurrentRoomIndex && RulesWorldStateUpdate.StateChanges.CurrentRoomIndex != State.CurrentRoomIndex)
 	{
-		WorldState.CurrentRoomIndex = RulesWorldStateUpdate.StateChanges.CurrentRoomIndex;
+		State.CurrentRoomIndex = RulesWorldStateUpdate.StateChanges.CurrentRoomIndex;
 	}
-	
-	ExecuteNarratorAgent(PlayerInput, RulesResultJson);
 }
 
 void UChatGPTManager::ExecuteNarratorAgent(const FString& PlayerInput, const FString& RulesResultJson /*=TEXT("N/A")*/, const bool bIsInitial /*=false*/)
@@ -139,16 +485,13 @@ void UChatGPTManager::ExecuteNarratorAgent(const FString& PlayerInput, const FSt
 	if (!IsValid(NarratorAgent))
 	{
 		UE_LOG(LogTemp, Error, TEXT("[UChatGPTManager::SendAgenticChatRequest()] Narrator agent is invalid."));
+		FinishTurn();
 		return;
 	}
 
-	// Bind so we can respond to the NarratorAgent completing its request and response processing.
-	if (!NarratorAgent->OnNarratorResultReady.IsAlreadyBound(this, &UChatGPTManager::HandleNarratorResult))
-	{
-		NarratorAgent->OnNarratorResultReady.AddDynamic(this, &UChatGPTManager::HandleNarratorResult);
-	}
+	BindNarratorAgent();
 
-	const FString CurrentWorldStateJSON = WorldStateToJson(WorldState);
+	const FString CurrentWorldStateJSON = WorldStateToJson(WorldState, NarratorAgent);
 
 	// Send an intro message when the game starts.
 	if (bIsInitial)
@@ -158,20 +501,70 @@ void UChatGPTManager::ExecuteNarratorAgent(const FString& PlayerInput, const FSt
 	// Default case: send the player's input with world state differences.
 	else
 	{
-		NarratorAgent->SendMessage(PlayerInput, CurrentWorldStateJSON, RulesResultJson);
+		// Whatever the rules didn't use of the turn's target is the narrator's to spend. A spent budget still needs to be positive to count.
+		float LatencyBudget = 0.0f;
+		if (TurnLatencyTargetSeconds > 0.0f)
+		{
+			LatencyBudget = FMath::Max(TurnLatencyTargetSeconds - static_cast<float>(FPlatformTime::Seconds() - TurnStartTime), 0.01f);
+		}
+		NarratorAgent->SendMessage(PlayerInput, CurrentWorldStateJSON, RulesResultJson, LatencyBudget);
+	}
+}
+
+void UChatGPTManager::BindNarratorAgent()
+{
+	// Bind so we can respond to the NarratorAgent completing its request and response processing.
+	if (!NarratorAgent->OnNarratorResultReady.IsAlreadyBound(this, &UChatGPTManager::HandleNarratorResult))
+	{
+		NarratorAgent->OnNarratorResultReady.AddDynamic(this, &UChatGPTManager::HandleNarratorResult);
+	}
+	if (!NarratorAgent->OnNarratorChunkReceived.IsAlreadyBound(this, &UChatGPTManager::HandleNarratorChunk))
+	{
+		NarratorAgent->OnNarratorChunkReceived.AddDynamic(this, &UChatGPTManager::HandleNarratorChunk);
 	}
 }
 
 void UChatGPTManager::HandleNarratorResult(const FString& NarratorResult, const FString& PlayerInput)
 {
 	// TODO: We shouldn't need to update WorldState here because Narrator should not be changing state.
-	
-	OnChatGptResponseReceived.Broadcast(NarratorResult, false);
+
+	// Narration for a turn that has already been given up on
+	if (TurnPhase != EChatDMTurnPhase::Narrating)
+	{
+		return;
+	}
+
+	CurrentTurnMetrics.Requests.Add(NarratorAgent->LastRequestMetrics);
+	DeliverNarration(NarratorResult);
 }
 
-FString UChatGPTManager::WorldStateToJson(const FWorldState& State)
+void UChatGPTManager::DeliverNarration(const FString& Narration)
 {
-	FString OutputString;
-	FJsonObjectConverter::UStructToJsonObjectString(State, OutputString);
-	return OutputString;
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(ChatDM_BroadcastNarration);
+
+		const double BroadcastStartTime = FPlatformTime::Seconds();
+		OnChatGptResponseReceived.Broadcast(Narration, false);
+		CurrentTurnMetrics.BroadcastSeconds = FPlatformTime::Seconds() - BroadcastStartTime;
+	}
+
+	FinishTurn();
+}
+
+void UChatGPTManager::HandleNarratorChunk(const FString& Chunk, bool bIsFirstChunk)
+{
+	OnChatGptResponseChunkReceived.Broadcast(Chunk, bIsFirstChunk);
+}
+
+FString UChatGPTManager::WorldStateToJson(const FWorldState& State, const UChatAgent* ForAgent /*=nullptr*/)
+{
+	// Without an agent we want the whole world, e.g. for comparing states
+	if (!ForAgent)
+	{
+		return FWorldStateView::ToJson(State, FWorldStateViewSettings());
+	}
+
+	// Agents that were sent the DUNGEON message only need what has changed since
+	const bool bVolatileOnly = ForAgent->HasDungeonMessage();
+	return FWorldStateView::ToJson(State, ForAgent->WorldStateView, bVolatileOnly ? EWorldStateParts::Volatile : EWorldStateParts::All);
 }
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include "ChatMetrics.h"
+
+#include "ProfilingDebugging/CountersTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+
+CSV_DEFINE_CATEGORY(ChatDM, true);
+
+TRACE_DECLARE_FLOAT_COUNTER(ChatDMRequestSeconds, TEXT("ChatDM/RequestSeconds"));
+TRACE_DECLARE_FLOAT_COUNTER(ChatDMTurnSeconds, TEXT("ChatDM/TurnSeconds"));
+TRACE_DECLARE_INT_COUNTER(ChatDMSessionTokens, TEXT("ChatDM/SessionTokens"));
+
+namespace
+{
+#if CSV_PROFILER
+	/** Agents are named at runtime, so their stats can't use the CSV_CUSTOM_STAT macros. */
+	void RecordAgentStat(const FString& Agent, const TCHAR* Stat, const float Value)
+	{
+		FCsvProfiler::RecordCustomStat(FName(*FString::Printf(TEXT("%s_%s"), *Agent, Stat)), CSV_CATEGORY_INDEX(ChatDM), Value, ECsvCustomStatOp::Accumulate);
+	}
+#endif
+}
+
+void FChatMetrics::ReportRequest(const FChatRequestMetrics& Metrics)
+{
+#if CSV_PROFILER
+	RecordAgentStat(Metrics.Agent, TEXT("BuildSeconds"), Metrics.BuildSeconds);
+	RecordAgentStat(Metrics.Agent, TEXT("QueueSeconds"), Metrics.QueueSeconds);
+	RecordAgentStat(Metrics.Agent, TEXT("FirstByteSeconds"), Metrics.FirstByteSeconds);
+	RecordAgentStat(Metrics.Agent, TEXT("HttpSeconds"), Metrics.HttpSeconds);
+	RecordAgentStat(Metrics.Agent, TEXT("ParseSeconds"), Metrics.ParseSeconds);
+	RecordAgentStat(Metrics.Agent, TEXT("TotalSeconds"), Metrics.TotalSeconds);
+	RecordAgentStat(Metrics.Agent, TEXT("PromptTokens"), Metrics.Usage.PromptTokens);
+	RecordAgentStat(Metrics.Agent, TEXT("CompletionTokens"), Metrics.Usage.CompletionTokens);
+	RecordAgentStat(Metrics.Agent, TEXT("CachedTokens"), Metrics.Usage.CachedTokens);
+#endif
+	TRACE_COUNTER_SET(ChatDMRequestSeconds, Metrics.TotalSeconds);
+
+	UE_LOG(LogTemp, Verbose, TEXT("%s request on %s: build %.4fs, queue %.3fs, first byte %.3fs, http %.3fs, parse %.4fs, total %.3fs, %d attempts%s, tokens %d prompt (%d estimated, %d cached) + %d completion."),
+		*Metrics.Agent,
+		*Metrics.Model,
+		Metrics.BuildSeconds,
+		Metrics.QueueSeconds,
+		Metrics.FirstByteSeconds,
+		Metrics.HttpSeconds,
+		Metrics.ParseSeconds,
+		Metrics.TotalSeconds,
+		Metrics.Attempts,
+		Metrics.bFromCache ? TEXT(" (cached reply)") : TEXT(""),
+		Metrics.Usage.PromptTokens,
+		Metrics.EstimatedPromptTokens,
+		Metrics.Usage.CachedTokens,
+		Metrics.Usage.CompletionTokens);
+}
+
+void FChatMetrics::ReportTurn(const FChatTurnMetrics& Metrics, const FChatTokenUsage& SessionUsage)
+{
+	CSV_CUSTOM_STAT(ChatDM, TurnSeconds, Metrics.TotalSeconds, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ChatDM, StateApplySeconds, Metrics.StateApplySeconds, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ChatDM, BroadcastSeconds, Metrics.BroadcastSeconds, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ChatDM, SessionTokens, SessionUsage.GetTotalTokens(), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ChatDM, SessionCachedTokens, SessionUsage.CachedTokens, ECsvCustomStatOp::Set);
+	TRACE_COUNTER_SET(ChatDMTurnSeconds, Metrics.TotalSeconds);
+	TRACE_COUNTER_SET(ChatDMSessionTokens, SessionUsage.GetTotalTokens());
+
+	// One line per turn that says where the time went
+	FString Breakdown;
+	for (const FChatRequestMetrics& Request : Metrics.Requests)
+	{
+		Breakdown += FString::Printf(TEXT(", %s %.3fs (queue %.3fs, first byte %.3fs, http %.3fs)"),
+			*Request.Agent, Request.TotalSeconds, Request.QueueSeconds, Request.FirstByteSeconds, Request.HttpSeconds);
+	}
+	UE_LOG(LogTemp, Log, TEXT("ChatDM turn: %.3fs%s, state apply %.4fs, broadcast %.4fs. Session tokens: %d prompt (%d cached), %d completion."),
+		Metrics.TotalSeconds,
+		*Breakdown,
+		Metrics.StateApplySeconds,
+		Metrics.BroadcastSeconds,
+		SessionUsage.PromptTokens,
+		SessionUsage.CachedTokens,
+		SessionUsage.CompletionTokens);
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "ChatModelRouter.h"
+
+#include "HAL/IConsoleManager.h"
+
+namespace
+{
+	/** Weight of the newest sample in the moving average. High enough to notice a model slowing down within a few turns. */
+	constexpr float LatencySmoothing = 0.2f;
+
+	FAutoConsoleCommand ModelStatsCommand(
+		TEXT("ChatDM.Models.Stats"),
+		TEXT("Logs the observed latency of every model the agents have used."),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			FChatModelRouter::Get().LogStats();
+		}));
+}
+
+FChatModelRouter& FChatModelRouter::Get()
+{
+	static FChatModelRouter Instance;
+	return Instance;
+}
+
+int32 FChatModelRouter::SelectTier(const TArray<FChatModelTier>& Tiers, const int32 PreferredTier, const float BudgetSeconds, const EChatLatencyKind Kind)
+{
+	check(IsInGameThread());
+
+	if (Tiers.IsEmpty())
+	{
+		return INDEX_NONE;
+	}
+
+	int32 Tier = FMath::Clamp(PreferredTier, 0, Tiers.Num() - 1);
+	if (BudgetSeconds <= 0.0f)
+	{
+		return Tier;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	while (Tier > 0)
+	{
+		FModelStats* Stats = Models.Find(Tiers[Tier].Model);
+		if (!Stats || Stats->Get(Kind).Samples == 0 || Stats->Get(Kind).AverageSeconds <= BudgetSeconds)
+		{
+			break;
+		}
+
+		// Nothing has refreshed this average for a while, so spend one request finding out whether it still holds.
+		// The probe time is kept apart from the sample time, so the probe's answer still finds the average stale and replaces it.
+		FLatencyStats& Latency = Stats->Get(Kind);
+		if (Now - FMath::Max(Latency.LastSampleTime, Latency.LastProbeTime) >= ProbeIntervalSeconds)
+		{
+			UE_LOG(LogTemp, Log, TEXT("FChatModelRouter: Probing %s, last seen at %.3fs against a %.3fs budget."), *Tiers[Tier].Model, Latency.AverageSeconds, BudgetSeconds);
+			Latency.LastProbeTime = Now;
+			break;
+		}
+		--Tier;
+	}
+	return Tier;
+}
+
+void FChatModelRouter::RecordLatency(const FString& Model, const EChatLatencyKind Kind, const float Seconds)
+{
+	check(IsInGameThread());
+
+	FLatencyStats& Stats = Models.FindOrAdd(Model).Get(Kind);
+	const double Now = FPlatformTime::Seconds();
+
+	// An average nobody has refreshed in a probe interval says little about the model now, so the new sample replaces it.
+	// Otherwise a probe that comes back fast would take many more turns to pull a tier back under budget.
+	const bool bStale = Now - Stats.LastSampleTime >= ProbeIntervalSeconds;
+	Stats.AverageSeconds = Stats.Samples == 0 || bStale ? Seconds : FMath::Lerp(Stats.AverageSeconds, Seconds, LatencySmoothing);
+	Stats.LastSampleTime = Now;
+	++Stats.Samples;
+}
+
+float FChatModelRouter::GetExpectedLatency(const FString& Model, const EChatLatencyKind Kind) const
+{
+	const FModelStats* Stats = Models.Find(Model);
+	return Stats && Stats->Get(Kind).Samples > 0 ? Stats->Get(Kind).AverageSeconds : -1.0f;
+}
+
+void FChatModelRouter::LogStats() const
+{
+	for (const TPair<FString, FModelStats>& Model : Models)
+	{
+		UE_LOG(LogTemp, Log, TEXT("FChatModelRouter: %s first token %.3fs over %d streamed replies, whole reply %.3fs over %d replies."),
+			*Model.Key,
+			Model.Value.FirstToken.AverageSeconds, Model.Value.FirstToken.Samples,
+			Model.Value.Total.AverageSeconds, Model.Value.Total.Samples);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "ChatPromptLibrary.h"
+
+#include "ChatPromptRow.h"
+#include "ChatRequestWriter.h"
+
+FChatPromptLibrary& FChatPromptLibrary::Get()
+{
+	static FChatPromptLibrary Instance;
+	return Instance;
+}
+
+bool FChatPromptLibrary::GetPrompt(const FName& RowName, FString& OutPrompt)
+{
+	LoadRows();
+
+	const FString* Prompt = Rows.Find(RowName);
+	if (!Prompt)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FChatPromptLibrary::GetPrompt(): Row %s not found in DataTable."), *RowName.ToString());
+		return false;
+	}
+
+	OutPrompt = *Prompt;
+	return true;
+}
+
+FChatMessage FChatPromptLibrary::MakeSystemMessage(const FString& Prompt)
+{
+	FChatMessage Message(TEXT("system"), Prompt);
+
+	TSharedPtr<const TArray<uint8>>& Encoded = EncodedSystemMessages.FindOrAdd(Prompt);
+	if (!Encoded.IsValid())
+	{
+		TArray<uint8> Bytes;
+		FChatRequestWriter::WriteMessage(Bytes, Message.Role, Message.Content);
+		Encoded = MakeShared<const TArray<uint8>>(MoveTemp(Bytes));
+	}
+	Message.EncodedJson = Encoded;
+
+	return Message;
+}
+
+void FChatPromptLibrary::LoadRows()
+{
+	if (bRowsLoaded)
+	{
+		return;
+	}
+	bRowsLoaded = true;
+
+	// Get a reference to the prompts DT
+	static const FString DataTablePath = TEXT("/Game/Assets/DT_Prompts.DT_Prompts");
+	const UDataTable* DataTable = Cast<UDataTable>(StaticLoadObject(UDataTable::StaticClass(), nullptr, *DataTablePath));
+	if (!DataTable)
+	{
+		UE_LOG(LogTemp, Error, TEXT("FChatPromptLibrary::LoadRows(): Failed to load DataTable at %s"), *DataTablePath);
+		return;
+	}
+
+	DataTable->ForeachRow<FChatPromptRow>(TEXT("FChatPromptLibrary::LoadRows"), [this](const FName& RowName, const FChatPromptRow& Row)
+	{
+		Rows.Add(RowName, Row.PromptText);
+	});
+
+	UE_LOG(LogTemp, Log, TEXT("FChatPromptLibrary::LoadRows(): Loaded %d prompts."), Rows.Num());
+}
\ No newline at end of file
@@ -0,0 +1,283 @@
+#include "ChatRateLimiter.h"
+
+#include "HAL/IConsoleManager.h"
+
+namespace
+{
+	/** Share of each bucket only player-facing requests may use, so background work can't starve a turn. */
+	constexpr double InteractiveReserveFraction = 0.1;
+
+	/** Reply tokens we budget for on top of the prompt when a request sets no max_tokens. The server counts the reply against the limit too. */
+	constexpr int32 ExpectedReplyTokens = 400;
+
+	/** How often queued requests are looked at again. */
+	constexpr float PumpIntervalSeconds = 0.05f;
+
+	FAutoConsoleCommand RateLimitStatsCommand(
+		TEXT("ChatDM.RateLimit.Stats"),
+		TEXT("Logs the shared rate limit buckets and how many agent requests had to wait for them."),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			FChatRateLimiter::Get().LogStats();
+		}));
+
+	/** Parse the header's duration format: "20ms", "1s", "6m0s", "1h2m3.5s". */
+	double ParseDurationSeconds(const FString& Value)
+	{
+		double Seconds = 0.0;
+		int32 Index = 0;
+		while (Index < Value.Len())
+		{
+			const int32 NumberStart = Index;
+			while (Index < Value.Len() && (FChar::IsDigit(Value[Index]) || Value[Index] == TEXT('.')))
+			{
+				++Index;
+			}
+			if (Index == NumberStart)
+			{
+				break;
+			}
+			const double Number = FCString::Atod(*Value.Mid(NumberStart, Index - NumberStart));
+
+			const int32 UnitStart = Index;
+			while (Index < Value.Len() && FChar::IsAlpha(Value[Index]))
+			{
+				++Index;
+			}
+			const FString Unit = Value.Mid(UnitStart, Index - UnitStart);
+
+			if (Unit == TEXT("h"))
+			{
+				Seconds += Number * 3600.0;
+			}
+			else if (Unit == TEXT("m"))
+			{
+				Seconds += Number * 60.0;
+			}
+			else if (Unit == TEXT("ms"))
+			{
+				Seconds += Number * 0.001;
+			}
+			else
+			{
+				Seconds += Number;
+			}
+		}
+		return Seconds;
+	}
+}
+
+FChatRateLimiter& FChatRateLimiter::Get()
+{
+	static FChatRateLimiter Instance;
+	return Instance;
+}
+
+void FChatRateLimiter::Submit(const EChatRequestPriority Priority, const int32 EstimatedTokens, TFunction<bool()> Launch, const double Deadline /*=0.0*/, TFunction<void()> OnExpired /*=nullptr*/)
+{
+	check(IsInGameThread());
+	Refill();
+
+	FPendingRequest Request{ Priority, EstimatedTokens, FPlatformTime::Seconds(), MoveTemp(Launch), Deadline, MoveTemp(OnExpired) };
+
+	// Behind everything of the same or higher priority
+	int32 InsertAt = Queue.IndexOfByPredicate([Priority](const FPendingRequest& Pending) { return Pending.Priority > Priority; });
+	if (InsertAt == INDEX_NONE)
+	{
+		InsertAt = Queue.Num();
+	}
+
+	// Nothing it has to wait behind, so it goes now if there's room
+	if (InsertAt == 0 && HasRoomFor(Request))
+	{
+		if (Request.Launch())
+		{
+			Requests.Remaining -= 1.0;
+			Tokens.Remaining -= EstimatedTokens;
+			++Stats.Immediate;
+		}
+		return;
+	}
+
+	Queue.Insert(MoveTemp(Request), InsertAt);
+	if (!TickerHandle.IsValid())
+	{
+		TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FChatRateLimiter::Tick), PumpIntervalSeconds);
+	}
+}
+
+bool FChatRateLimiter::NoteResponse(const FHttpResponsePtr& Response)
+{
+	if (!Response.IsValid())
+	{
+		return false;
+	}
+
+	const FString RemainingRequests = Response->GetHeader(TEXT("x-ratelimit-remaining-requests"));
+	const FString RemainingTokens = Response->GetHeader(TEXT("x-ratelimit-remaining-tokens"));
+	const bool bHasHeaders = !RemainingRequests.IsEmpty() || !RemainingTokens.IsEmpty();
+
+	// The server's counts already include everything it has seen from us, so they replace our own
+	Refill();
+	UpdateBucket(Requests, Response->GetHeader(TEXT("x-ratelimit-limit-requests")), RemainingRequests, Response->GetHeader(TEXT("x-ratelimit-reset-requests")));
+	UpdateBucket(Tokens, Response->GetHeader(TEXT("x-ratelimit-limit-tokens")), RemainingTokens, Response->GetHeader(TEXT("x-ratelimit-reset-tokens")));
+
+	if (Response->GetResponseCode() == EHttpResponseCodes::TooManyRequests)
+	{
+		++Stats.RateLimited;
+
+		// Hold everything back until the server says we can go again
+		double WaitSeconds = 1.0;
+		const FString RetryAfter = Response->GetHeader(TEXT("Retry-After"));
+		if (RetryAfter.IsNumeric())
+		{
+			WaitSeconds = FMath::Max(WaitSeconds, FCString::Atod(*RetryAfter));
+		}
+		if (Requests.Remaining < 1.0)
+		{
+			WaitSeconds = FMath::Max(WaitSeconds, ParseDurationSeconds(Response->GetHeader(TEXT("x-ratelimit-reset-requests"))));
+		}
+		BlockedUntil = FMath::Max(BlockedUntil, FPlatformTime::Seconds() + WaitSeconds);
+	}
+
+	return bHasHeaders;
+}
+
+void FChatRateLimiter::NoteUsage(const int32 EstimatedTokens, const int32 ActualTokens)
+{
+	if (Tokens.Limit > 0.0)
+	{
+		Tokens.Remaining = FMath::Min(Tokens.Limit, Tokens.Remaining + EstimatedTokens - ActualTokens);
+	}
+}
+
+int32 FChatRateLimiter::EstimateRequestTokens(const int32 PromptTokens, const int32 MaxReplyTokens)
+{
+	return PromptTokens + (MaxReplyTokens > 0 ? MaxReplyTokens : ExpectedReplyTokens);
+}
+
+void FChatRateLimiter::LogStats() const
+{
+	UE_LOG(LogTemp, Log, TEXT("FChatRateLimiter: requests %.0f/%.0f, tokens %.0f/%.0f, %d sent immediately, %d delayed (avg %.3fs), %d dropped while queued, %d expired while queued, %d rate limited, %d queued."),
+		Requests.Remaining, Requests.Limit,
+		Tokens.Remaining, Tokens.Limit,
+		Stats.Immediate,
+		Stats.Delayed,
+		Stats.Delayed > 0 ? Stats.DelayedSeconds / Stats.Delayed : 0.0,
+		Stats.Dropped,
+		Stats.Expired,
+		Stats.RateLimited,
+		Queue.Num());
+}
+
+bool FChatRateLimiter::HasRoomFor(const FPendingRequest& Request) const
+{
+	if (FPlatformTime::Seconds() < BlockedUntil)
+	{
+		return false;
+	}
+
+	const double Reserve = Request.Priority == EChatRequestPriority::Interactive ? 0.0 : InteractiveReserveFraction;
+	auto Fits = [Reserve](const FBucket& Bucket, const double Cost)
+	{
+		// An unknown limit doesn't hold anything back. A request bigger than the whole bucket waits for a full one.
+		return Bucket.Limit <= 0.0 || Bucket.Remaining - Bucket.Limit * Reserve >= FMath::Min(Cost, Bucket.Limit * (1.0 - Reserve));
+	};
+	return Fits(Requests, 1.0) && Fits(Tokens, Request.EstimatedTokens);
+}
+
+void FChatRateLimiter::Pump()
+{
+	ExpireQueued();
+	Refill();
+
+	while (!Queue.IsEmpty() && HasRoomFor(Queue[0]))
+	{
+		FPendingRequest Request = MoveTemp(Queue[0]);
+		Queue.RemoveAt(0);
+
+		if (Request.Launch())
+		{
+			Requests.Remaining -= 1.0;
+			Tokens.Remaining -= Request.EstimatedTokens;
+			++Stats.Delayed;
+			Stats.DelayedSeconds += FPlatformTime::Seconds() - Request.QueuedTime;
+		}
+		else
+		{
+			++Stats.Dropped;
+		}
+	}
+}
+
+void FChatRateLimiter::ExpireQueued()
+{
+	const double Now = FPlatformTime::Seconds();
+	TArray<FPendingRequest> Expired;
+	for (int32 Index = Queue.Num() - 1; Index >= 0; --Index)
+	{
+		if (Queue[Index].Deadline > 0.0 && Now >= Queue[Index].Deadline)
+		{
+			Expired.Add(MoveTemp(Queue[Index]));
+			Queue.RemoveAt(Index);
+		}
+	}
+
+	// Only once the queue is settled, the owners may well submit something else from their callbacks
+	for (int32 Index = Expired.Num() - 1; Index >= 0; --Index)
+	{
+		++Stats.Expired;
+		if (Expired[Index].OnExpired)
+		{
+			Expired[Index].OnExpired();
+		}
+	}
+}
+
+void FChatRateLimiter::Refill()
+{
+	const double Now = FPlatformTime::Seconds();
+	const double Elapsed = LastRefillTime > 0.0 ? Now - LastRefillTime : 0.0;
+	LastRefillTime = Now;
+
+	for (FBucket* Bucket : { &Requests, &Tokens })
+	{
+		if (Bucket->Limit > 0.0)
+		{
+			Bucket->Remaining = FMath::Min(Bucket->Limit, Bucket->Remaining + Bucket->RefillPerSecond * Elapsed);
+		}
+	}
+}
+
+bool FChatRateLimiter::Tick(float DeltaTime)
+{
+	Pump();
+
+	if (Queue.IsEmpty())
+	{
+		TickerHandle.Reset();
+		return false;
+	}
+	return true;
+}
+
+void FChatRateLimiter::UpdateBucket(FBucket& Bucket, const FString& LimitHeader, const FString& RemainingHeader, const FString& ResetHeader)
+{
+	if (LimitHeader.IsNumeric())
+	{
+		Bucket.Limit = FCString::Atod(*LimitHeader);
+	}
+	if (RemainingHeader.IsNumeric())
+	{
+		Bucket.Remaining = FCString::Atod(*RemainingHeader);
+	}
+	if (Bucket.Limit <= 0.0)
+	{
+		return;
+	}
+
+	// Limits are per minute, and the reset header says how long until the bucket is full again
+	const double ResetSeconds = ParseDurationSeconds(ResetHeader);
+	const double Missing = Bucket.Limit - Bucket.Remaining;
+	Bucket.RefillPerSecond = ResetSeconds > 0.0 && Missing > 0.0 ? Missing / ResetSeconds : Bucket.Limit / 60.0;
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include "ChatRequestWriter.h"
+
+void FChatRequestWriter::WriteRaw(TArray<uint8>& Out, const FAnsiStringView Literal)
+{
+	Out.Append(reinterpret_cast<const uint8*>(Literal.GetData()), Literal.Len());
+}
+
+void FChatRequestWriter::WriteString(TArray<uint8>& Out, const FStringView Text)
+{
+	static const uint8 HexDigits[] = "0123456789abcdef";
+
+	// Worst case for the common (ASCII) text is a couple of escapes, so one reserve up front is usually enough
+	Out.Reserve(Out.Num() + Text.Len() + 2);
+	Out.Add('"');
+
+	const TCHAR* Chars = Text.GetData();
+	const int32 Len = Text.Len();
+	for (int32 Index = 0; Index < Len; ++Index)
+	{
+		uint32 CodePoint = static_cast<uint32>(Chars[Index]);
+
+		// Plain ASCII that needs no escaping is by far the most common case
+		if (CodePoint >= 0x20 && CodePoint < 0x80 && CodePoint != '"' && CodePoint != '\\')
+		{
+			Out.Add(static_cast<uint8>(CodePoint));
+			continue;
+		}
+
+		if (CodePoint < 0x80)
+		{
+			Out.Add('\\');
+			switch (CodePoint)
+			{
+			case '"':  Out.Add('"'); break;
+			case '\\': Out.Add('\\'); break;
+			case '\n': Out.Add('n'); break;
+			case '\r': Out.Add('r'); break;
+			case '\t': Out.Add('t'); break;
+			case '\b': Out.Add('b'); break;
+			case '\f': Out.Add('f'); break;
+			default:
+				Out.Add('u');
+				Out.Add('0');
+				Out.Add('0');
+				Out.Add(HexDigits[(CodePoint >> 4) & 0xF]);
+				Out.Add(HexDigits[CodePoint & 0xF]);
+				break;
+			}
+			continue;
+		}
+
+		// Join UTF-16 surrogate pairs; a lone surrogate becomes U+FFFD
+		if (CodePoint >= 0xD800 && CodePoint <= 0xDBFF)
+		{
+			const uint32 Low = Index + 1 < Len ? static_cast<uint32>(Chars[Index + 1]) : 0;
+			if (Low >= 0xDC00 && Low <= 0xDFFF)
+			{
+				CodePoint = 0x10000 + ((CodePoint - 0xD800) << 10) + (Low - 0xDC00);
+				++Index;
+			}
+			else
+			{
+				CodePoint = 0xFFFD;
+			}
+		}
+		else if (CodePoint >= 0xDC00 && CodePoint <= 0xDFFF)
+		{
+			CodePoint = 0xFFFD;
+		}
+
+		if (CodePoint < 0x800)
+		{
+			Out.Add(static_cast<uint8>(0xC0 | (CodePoint >> 6)));
+			Out.Add(static_cast<uint8>(0x80 | (CodePoint & 0x3F)));
+		}
+		else if (CodePoint < 0x10000)
+		{
+			Out.Add(static_cast<uint8>(0xE0 | (CodePoint >> 12)));
+			Out.Add(static_cast<uint8>(0x80 | ((CodePoint >> 6) & 0x3F)));
+			Out.Add(static_cast<uint8>(0x80 | (CodePoint & 0x3F)));
+		}
+		else
+		{
+			Out.Add(static_cast<uint8>(0xF0 | (CodePoint >> 18)));
+			Out.Add(static_cast<uint8>(0x80 | ((CodePoint >> 12) & 0x3F)));
+			Out.Add(static_cast<uint8>(0x80 | ((CodePoint >> 6) & 0x3F)));
+			Out.Add(static_cast<uint8>(0x80 | (CodePoint & 0x3F)));
+		}
+	}
+
+	Out.Add('"');
+}
+
+void FChatRequestWriter::WriteMessage(TArray<uint8>& Out, const FStringView Role, const FStringView Content)
+{
+	WriteRaw(Out, "{\"role\":");
+	WriteString(Out, Role);
+	WriteRaw(Out, ",\"content\":");
+	WriteString(Out, Content);
+	WriteRaw(Out, "}");
+}
+
+void FChatRequestWriter::WriteCachedMessage(TArray<uint8>& Out, FChatMessage& Message)
+{
+	if (!Message.EncodedJson.IsValid())
+	{
+		TArray<uint8> Encoded;
+		WriteMessage(Encoded, Message.Role, Message.Content);
+		Message.EncodedJson = MakeShared<const TArray<uint8>>(MoveTemp(Encoded));
+	}
+
+	Out.Append(*Message.EncodedJson);
+}
\ No newline at end of file
@@ -0,0 +1,300 @@
+#include "ChatResponseCache.h"
+
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	/** Replies kept in memory. Each one is a few KB of narration at most. */
+	constexpr int32 MaxMemoryEntries = 256;
+
+	/** Limits for the entry files, past either one the least recently used files are deleted. */
+	constexpr int32 MaxDiskEntries = 4096;
+	constexpr int64 MaxDiskBytes = 32 * 1024 * 1024;
+
+	FAutoConsoleCommand ResponseCacheStatsCommand(
+		TEXT("ChatDM.ResponseCache.Stats"),
+		TEXT("Logs the agent response cache's hit rate, bytes served and time saved."),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			FChatResponseCache::Get().LogStats();
+		}));
+}
+
+FChatResponseCache& FChatResponseCache::Get()
+{
+	static FChatResponseCache Instance;
+	return Instance;
+}
+
+FChatResponseCache::FChatResponseCache()
+	: MemoryEntries(MaxMemoryEntries)
+	, Directory(FPaths::ProjectSavedDir() / TEXT("ChatDM") / TEXT("ResponseCache"))
+	, FilePipe(TEXT("ChatResponseCache"))
+{
+	// Find what earlier sessions left behind without holding up the first requests
+	FilePipe.Launch(UE_SOURCE_LOCATION, [this]()
+	{
+		TSharedRef<FDirectoryIndex> Index = MakeShared<FDirectoryIndex>(BuildDirectoryIndex());
+		AsyncTask(ENamedThreads::GameThread, [this, Index]()
+		{
+			ApplyDirectoryIndex(MoveTemp(Index.Get()));
+		});
+	});
+}
+
+FSHAHash FChatResponseCache::MakeKey(const TConstArrayView<uint8> RequestBody)
+{
+	FSHAHash Key;
+	FSHA1::HashBuffer(RequestBody.GetData(), RequestBody.Num(), Key.Hash);
+	return Key;
+}
+
+bool FChatResponseCache::Find(const FSHAHash& Key, FString& OutContent)
+{
+	check(IsInGameThread());
+
+	if (const FEntry* Entry = MemoryEntries.FindAndTouch(Key))
+	{
+		if (Entry->bFromDisk)
+		{
+			++Stats.DiskHits;
+		}
+		else
+		{
+			++Stats.MemoryHits;
+		}
+		ServeEntry(*Entry, OutContent);
+
+		if (FDiskEntry* DiskEntry = DiskEntries.Find(Key))
+		{
+			DiskEntry->LastUsed = ++UseCounter;
+		}
+		return true;
+	}
+
+	// Only on disk, so read it in the background for the next time this exact request comes up
+	if (DiskEntries.Contains(Key) && !PendingLoads.Contains(Key))
+	{
+		LoadEntryAsync(Key);
+	}
+
+	++Stats.Misses;
+	return false;
+}
+
+void FChatResponseCache::Add(const FSHAHash& Key, const FString& Content, const double LatencySeconds)
+{
+	check(IsInGameThread());
+
+	MemoryEntries.Add(Key, FEntry{ Content, LatencySeconds });
+
+	FString FileContents = FString::Printf(TEXT("%f\n%s"), LatencySeconds, *Content);
+	FDiskEntry& DiskEntry = DiskEntries.FindOrAdd(Key);
+	DiskBytes -= DiskEntry.Bytes;
+	DiskEntry.Bytes = FTCHARToUTF8(*FileContents).Length();
+	DiskEntry.LastUsed = ++UseCounter;
+	DiskBytes += DiskEntry.Bytes;
+
+	FilePipe.Launch(UE_SOURCE_LOCATION, [Path = GetEntryPath(Key), FileContents = MoveTemp(FileContents)]()
+	{
+		if (!FFileHelper::SaveStringToFile(FileContents, *Path, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("FChatResponseCache::Add(): Failed to write %s, the reply is only cached in memory."), *Path);
+		}
+	});
+
+	EnforceDiskLimits();
+}
+
+void FChatResponseCache::LogStats() const
+{
+	UE_LOG(LogTemp, Log, TEXT("FChatResponseCache: hit rate %.0f%% (%d memory, %d disk, %d misses), %lld bytes served, %.2fs of round trips saved, %d files (%lld bytes) on disk, %d evicted."),
+		Stats.GetHitRate() * 100.0f,
+		Stats.MemoryHits,
+		Stats.DiskHits,
+		Stats.Misses,
+		Stats.BytesServed,
+		Stats.SavedSeconds,
+		DiskEntries.Num(),
+		DiskBytes,
+		Stats.Evictions);
+}
+
+FString FChatResponseCache::GetEntryPath(const FSHAHash& Key) const
+{
+	return Directory / Key.ToString() + TEXT(".txt");
+}
+
+bool FChatResponseCache::ParseEntryFile(const FString& FileContents, FEntry& OutEntry)
+{
+	int32 Newline = INDEX_NONE;
+	if (!FileContents.FindChar(TEXT('\n'), Newline))
+	{
+		return false;
+	}
+
+	OutEntry.LatencySeconds = FCString::Atod(*FileContents.Left(Newline));
+	OutEntry.Content = FileContents.RightChop(Newline + 1);
+	OutEntry.bFromDisk = true;
+	return true;
+}
+
+FChatResponseCache::FDirectoryIndex FChatResponseCache::BuildDirectoryIndex() const
+{
+	struct FFoundFile
+	{
+		FSHAHash Key;
+		FString Path;
+		int64 Bytes = 0;
+		FDateTime ModificationTime;
+	};
+
+	IFileManager& FileManager = IFileManager::Get();
+	TArray<FFoundFile> FoundFiles;
+	FileManager.IterateDirectoryStat(*Directory, [&FoundFiles](const TCHAR* Path, const FFileStatData& StatData)
+	{
+		const FString Name = FPaths::GetBaseFilename(Path);
+		if (!StatData.bIsDirectory && FPaths::GetExtension(Path) == TEXT("txt") && Name.Len() == 40)
+		{
+			FFoundFile& File = FoundFiles.Emplace_GetRef();
+			File.Key.FromString(Name);
+			File.Path = Path;
+			File.Bytes = StatData.FileSize;
+			File.ModificationTime = StatData.ModificationTime;
+		}
+		return true;
+	});
+
+	// Files are written once, so the newest are the ones most likely to be asked for again
+	FoundFiles.Sort([](const FFoundFile& A, const FFoundFile& B) { return A.ModificationTime > B.ModificationTime; });
+
+	FDirectoryIndex Index;
+	int64 KeptBytes = 0;
+	for (const FFoundFile& File : FoundFiles)
+	{
+		if (Index.Files.Num() >= MaxDiskEntries || KeptBytes + File.Bytes > MaxDiskBytes)
+		{
+			FileManager.Delete(*File.Path);
+			++Index.Deleted;
+			continue;
+		}
+
+		KeptBytes += File.Bytes;
+		Index.Files.Emplace(File.Key, File.Bytes);
+
+		// Warm the memory cache with the newest replies, restarting and replaying the same turns is the common case
+		FString FileContents;
+		FEntry Entry;
+		if (Index.Preloaded.Num() < MaxMemoryEntries && FFileHelper::LoadFileToString(FileContents, *File.Path) && ParseEntryFile(FileContents, Entry))
+		{
+			Index.Preloaded.Emplace(File.Key, MoveTemp(Entry));
+		}
+	}
+	return Index;
+}
+
+void FChatResponseCache::ApplyDirectoryIndex(FDirectoryIndex&& Index)
+{
+	check(IsInGameThread());
+
+	Stats.Evictions += Index.Deleted;
+
+	// Oldest first, so the newest files end up the most recently used. Anything added while the scan ran is newer still.
+	const uint64 ScanBase = UseCounter;
+	UseCounter += Index.Files.Num();
+	for (int32 FileIndex = 0; FileIndex < Index.Files.Num(); ++FileIndex)
+	{
+		const TPair<FSHAHash, int64>& File = Index.Files[FileIndex];
+		if (!DiskEntries.Contains(File.Key))
+		{
+			DiskEntries.Add(File.Key, FDiskEntry{ File.Value, ScanBase + Index.Files.Num() - FileIndex });
+			DiskBytes += File.Value;
+		}
+	}
+
+	for (int32 EntryIndex = Index.Preloaded.Num() - 1; EntryIndex >= 0; --EntryIndex)
+	{
+		TPair<FSHAHash, FEntry>& Preloaded = Index.Preloaded[EntryIndex];
+		if (!MemoryEntries.Contains(Preloaded.Key))
+		{
+			MemoryEntries.Add(Preloaded.Key, MoveTemp(Preloaded.Value));
+		}
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("FChatResponseCache: indexed %d cached replies (%lld bytes), %d loaded into memory, %d deleted over the limits."),
+		DiskEntries.Num(), DiskBytes, Index.Preloaded.Num(), Index.Deleted);
+
+	EnforceDiskLimits();
+}
+
+void FChatResponseCache::LoadEntryAsync(const FSHAHash& Key)
+{
+	PendingLoads.Add(Key);
+
+	FilePipe.Launch(UE_SOURCE_LOCATION, [this, Key, Path = GetEntryPath(Key)]()
+	{
+		FString FileContents;
+		TSharedRef<FEntry> Entry = MakeShared<FEntry>();
+		const bool bLoaded = FFileHelper::LoadFileToString(FileContents, *Path) && ParseEntryFile(FileContents, Entry.Get());
+
+		AsyncTask(ENamedThreads::GameThread, [this, Key, Entry, bLoaded]()
+		{
+			PendingLoads.Remove(Key);
+			if (!bLoaded)
+			{
+				// Deleted or mangled behind our back, forget it
+				if (const FDiskEntry* DiskEntry = DiskEntries.Find(Key))
+				{
+					DiskBytes -= DiskEntry->Bytes;
+					DiskEntries.Remove(Key);
+				}
+				return;
+			}
+
+			if (DiskEntries.Contains(Key) && !MemoryEntries.Contains(Key))
+			{
+				MemoryEntries.Add(Key, MoveTemp(Entry.Get()));
+			}
+		});
+	});
+}
+
+void FChatResponseCache::EnforceDiskLimits()
+{
+	// Never evict the only entry, a single reply over the byte limit is still worth keeping until the next one lands
+	while (DiskEntries.Num() > 1 && (DiskEntries.Num() > MaxDiskEntries || DiskBytes > MaxDiskBytes))
+	{
+		const FSHAHash* OldestKey = nullptr;
+		uint64 OldestUse = MAX_uint64;
+		for (const TPair<FSHAHash, FDiskEntry>& Pair : DiskEntries)
+		{
+			if (Pair.Value.LastUsed < OldestUse)
+			{
+				OldestKey = &Pair.Key;
+				OldestUse = Pair.Value.LastUsed;
+			}
+		}
+
+		const FSHAHash Key = *OldestKey;
+		DiskBytes -= DiskEntries.FindChecked(Key).Bytes;
+		DiskEntries.Remove(Key);
+		++Stats.Evictions;
+
+		FilePipe.Launch(UE_SOURCE_LOCATION, [Path = GetEntryPath(Key)]()
+		{
+			IFileManager::Get().Delete(*Path);
+		});
+	}
+}
+
+void FChatResponseCache::ServeEntry(const FEntry& Entry, FString& OutContent)
+{
+	OutContent = Entry.Content;
+	Stats.BytesServed += FTCHARToUTF8(*Entry.Content).Length();
+	Stats.SavedSeconds += Entry.LatencySeconds;
+	UE_LOG(LogTemp, Verbose, TEXT("FChatResponseCache: served %d chars, hit rate now %.0f%%."), Entry.Content.Len(), Stats.GetHitRate() * 100.0f);
+}
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include "ChatResponseSchema.h"
+
+#include "ChatRequestWriter.h"
+#include "JsonObjectConverter.h"
+
+namespace
+{
+	/** What the model is told about a reply field. */
+	struct FResponseField
+	{
+		const TCHAR* JsonName;
+		/** Nullptr for fields whose name says it all. */
+		const TCHAR* Description;
+	};
+
+	/**
+	 * Every field of the reply structs, keyed by "Struct.Property". Kept in code rather than read from the JsonProperty and ToolTip
+	 * metadata, which is compiled out of shipping builds, so every build sends the model the same schema. Editor builds check
+	 * the names against the metadata, so a renamed or added field is caught there.
+	 */
+	const FResponseField* FindResponseField(const FProperty* Property)
+	{
+		static const TMap<FString, FResponseField> Fields =
+		{
+			{ TEXT("RulesUpdate.bSuccess"), { TEXT("success"), TEXT("Whether the player's action succeeded or failed according to the Rules Agent.") } },
+			{ TEXT("RulesUpdate.Reason"), { TEXT("reason"), TEXT("Why the action succeeded or failed.") } },
+			{ TEXT("RulesUpdate.ItemsPickedUp"), { TEXT("itemsPickedUp"), TEXT("The list of any new items picked up during the player's action.") } },
+			{ TEXT("RulesUpdate.StateChanges"), { TEXT("stateChanges"), TEXT("Struct of any changes that need to be made to the World State.") } },
+			{ TEXT("WorldStateUpdate.CurrentRoomIndex"), { TEXT("currentRoomIndex"), nullptr } },
+			{ TEXT("WorldStateUpdate.PlayerHeldItems"), { TEXT("playerHeldItems"), nullptr } },
+			{ TEXT("WorldStateUpdate.Rooms"), { TEXT("rooms"), nullptr } },
+			{ TEXT("RoomUpdate.RoomIndex"), { TEXT("roomIndex"), nullptr } },
+			{ TEXT("RoomUpdate.Items"), { TEXT("items"), nullptr } },
+			{ TEXT("RoomUpdate.Enemies"), { TEXT("enemies"), nullptr } },
+			{ TEXT("EnemyUpdate.EnemyIndex"), { TEXT("enemyIndex"), nullptr } },
+			{ TEXT("EnemyUpdate.Name"), { TEXT("name"), nullptr } },
+			{ TEXT("EnemyUpdate.Health"), { TEXT("health"), nullptr } },
+			{ TEXT("EnemyUpdate.Status"), { TEXT("status"), nullptr } },
+			{ TEXT("CombinedTurnResult.Rules"), { TEXT("rules"), TEXT("The rules evaluation, in the same shape the Rules Agent returns.") } },
+			{ TEXT("CombinedTurnResult.Narration"), { TEXT("narration"), TEXT("The narration shown to the player.") } },
+		};
+
+		const FResponseField* Field = Fields.Find(Property->GetOwnerStruct()->GetName() + TEXT(".") + Property->GetName());
+#if WITH_METADATA
+		const FString& JsonProperty = Property->GetMetaData(TEXT("JsonProperty"));
+		ensureMsgf(JsonProperty == (Field ? Field->JsonName : TEXT("")), TEXT("FChatResponseSchema: %s is named \"%s\" in its metadata but \"%s\" in the response field table."),
+			*Property->GetPathName(), *JsonProperty, Field ? Field->JsonName : TEXT("(missing)"));
+#endif
+		return Field;
+	}
+
+	void WriteStructSchema(TArray<uint8>& Out, const UScriptStruct* Struct);
+
+	/** Append the schema for a single property value. Returns false for property types we can't describe. */
+	bool WritePropertySchema(TArray<uint8>& Out, const FProperty* Property)
+	{
+		if (Property->IsA<FBoolProperty>())
+		{
+			FChatRequestWriter::WriteRaw(Out, "{\"type\":\"boolean\"");
+		}
+		else if (const FNumericProperty* NumericProperty = CastField<FNumericProperty>(Property); NumericProperty && !NumericProperty->IsEnum())
+		{
+			FChatRequestWriter::WriteRaw(Out, NumericProperty->IsInteger() ? "{\"type\":\"integer\"" : "{\"type\":\"number\"");
+		}
+		else if (Property->IsA<FStrProperty>() || Property->IsA<FNameProperty>() || Property->IsA<FTextProperty>())
+		{
+			FChatRequestWriter::WriteRaw(Out, "{\"type\":\"string\"");
+		}
+		else if (const FArrayProperty* ArrayProperty = CastField<FArrayProperty>(Property))
+		{
+			FChatRequestWriter::WriteRaw(Out, "{\"type\":\"array\",\"items\":");
+			if (!WritePropertySchema(Out, ArrayProperty->Inner))
+			{
+				return false;
+			}
+		}
+		else if (const FStructProperty* StructProperty = CastField<FStructProperty>(Property))
+		{
+			// Nested objects carry their own description, so there's nothing to add after them
+			WriteStructSchema(Out, StructProperty->Struct);
+			return true;
+		}
+		else
+		{
+			UE_LOG(LogTemp, Warning, TEXT("FChatResponseSchema: %s has a type with no JSON schema mapping, leaving it out."), *Property->GetPathName());
+			return false;
+		}
+
+		// Array elements share the array's field, only the outer schema gets the description
+		const FResponseField* Field = Property->GetOwner<FArrayProperty>() ? nullptr : FindResponseField(Property);
+		if (Field && Field->Description)
+		{
+			FChatRequestWriter::WriteRaw(Out, ",\"description\":");
+			FChatRequestWriter::WriteString(Out, Field->Description);
+		}
+
+		FChatRequestWriter::WriteRaw(Out, "}");
+		return true;
+	}
+
+	/** Append a strict object schema: every property required and nothing else allowed, as structured outputs demand. */
+	void WriteStructSchema(TArray<uint8>& Out, const UScriptStruct* Struct)
+	{
+		TArray<FString, TInlineAllocator<16>> Required;
+
+		FChatRequestWriter::WriteRaw(Out, "{\"type\":\"object\",\"properties\":{");
+		for (TFieldIterator<FProperty> It(Struct); It; ++It)
+		{
+			const FString JsonName = FChatResponseSchema::GetJsonName(*It);
+			const int32 PropertyStart = Out.Num();
+			if (Required.Num() > 0)
+			{
+				FChatRequestWriter::WriteRaw(Out, ",");
+			}
+			FChatRequestWriter::WriteString(Out, JsonName);
+			FChatRequestWriter::WriteRaw(Out, ":");
+
+			if (!WritePropertySchema(Out, *It))
+			{
+				Out.SetNum(PropertyStart, EAllowShrinking::No);
+				continue;
+			}
+			Required.Add(JsonName);
+		}
+
+		FChatRequestWriter::WriteRaw(Out, "},\"required\":[");
+		for (int32 Index = 0; Index < Required.Num(); ++Index)
+		{
+			if (Index > 0)
+			{
+				FChatRequestWriter::WriteRaw(Out, ",");
+			}
+			FChatRequestWriter::WriteString(Out, Required[Index]);
+		}
+		FChatRequestWriter::WriteRaw(Out, "],\"additionalProperties\":false}");
+	}
+}
+
+TSharedRef<const TArray<uint8>> FChatResponseSchema::GetResponseFormat(const UScriptStruct* Struct)
+{
+	check(IsInGameThread());
+	check(Struct);
+
+	static TMap<const UScriptStruct*, TSharedRef<const TArray<uint8>>> Cache;
+	if (const TSharedRef<const TArray<uint8>>* Cached = Cache.Find(Struct))
+	{
+		return *Cached;
+	}
+
+	// Schema names may only contain letters, digits, '_' and '-', which UHT struct names already satisfy
+	const TSharedRef<TArray<uint8>> ResponseFormat = MakeShared<TArray<uint8>>();
+	FChatRequestWriter::WriteRaw(*ResponseFormat, "{\"type\":\"json_schema\",\"json_schema\":{\"name\":");
+	FChatRequestWriter::WriteString(*ResponseFormat, Struct->GetName());
+	FChatRequestWriter::WriteRaw(*ResponseFormat, ",\"strict\":true,\"schema\":");
+	WriteStructSchema(*ResponseFormat, Struct);
+	FChatRequestWriter::WriteRaw(*ResponseFormat, "}}");
+
+	UE_LOG(LogTemp, Log, TEXT("FChatResponseSchema: Built %d byte response format for %s."), ResponseFormat->Num(), *Struct->GetName());
+	return Cache.Add(Struct, ResponseFormat);
+}
+
+FString FChatResponseSchema::GetJsonName(const FProperty* Property)
+{
+	if (const FResponseField* Field = FindResponseField(Property))
+	{
+		return Field->JsonName;
+	}
+
+	// Not a reply field, so use the same name FJsonObjectConverter would
+	return FJsonObjectConverter::StandardizeCase(Property->GetName());
+}
\ No newline at end of file
@@ -0,0 +1,346 @@
+#include "ChatTokenizer.h"
+
+#include "Hash/CityHash.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Base64.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	/** Vocab files looked for under Content/Tokenizer, first one found wins. */
+	const TCHAR* const VocabularyFiles[] = { TEXT("o200k_base.tiktoken"), TEXT("cl100k_base.tiktoken") };
+
+	/** Distinct pieces whose counts are remembered. A session's prompts only use a few thousand. */
+	constexpr int32 MaxCachedPieces = 32768;
+
+	/** Merging is quadratic in a piece's length, so longer pieces (long symbol runs, encoded data) are merged in chunks. */
+	constexpr int32 MaxPieceBytes = 256;
+
+	FAutoConsoleCommand TokenizerStatsCommand(
+		TEXT("ChatDM.Tokenizer.Stats"),
+		TEXT("Logs the prompt tokenizer's vocab, tokens counted and piece cache hit rate."),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			FChatTokenizer::Get().LogStats();
+		}));
+
+	bool IsNewline(const TCHAR Char)
+	{
+		return Char == TEXT('\r') || Char == TEXT('\n');
+	}
+
+	bool IsSymbol(const TCHAR Char)
+	{
+		return !FChar::IsWhitespace(Char) && !FChar::IsAlpha(Char) && !FChar::IsDigit(Char);
+	}
+
+	/** End of the piece that starts at Start, split the way the cl100k/o200k patterns split text (close enough for counting). */
+	int32 FindPieceEnd(const FStringView Text, const int32 Start)
+	{
+		const int32 Len = Text.Len();
+		const TCHAR First = Text[Start];
+		int32 Index = Start + 1;
+
+		// Contractions: 's 't 'm 'd 're 've 'll
+		if (First == TEXT('\'') && Index < Len)
+		{
+			const TCHAR Second = FChar::ToLower(Text[Index]);
+			if (Second == TEXT('s') || Second == TEXT('t') || Second == TEXT('m') || Second == TEXT('d'))
+			{
+				return Index + 1;
+			}
+
+			const TCHAR Third = Index + 1 < Len ? FChar::ToLower(Text[Index + 1]) : TEXT('\0');
+			if (((Second == TEXT('r') || Second == TEXT('v')) && Third == TEXT('e')) || (Second == TEXT('l') && Third == TEXT('l')))
+			{
+				return Index + 2;
+			}
+		}
+
+		// Words, with at most one leading space or symbol: " goblin", "(goblin"
+		if (FChar::IsAlpha(First) || (!IsNewline(First) && !FChar::IsDigit(First) && Index < Len && FChar::IsAlpha(Text[Index])))
+		{
+			while (Index < Len && FChar::IsAlpha(Text[Index]))
+			{
+				++Index;
+			}
+			return Index;
+		}
+
+		// Numbers, up to three digits at a time
+		if (FChar::IsDigit(First))
+		{
+			while (Index < Len && Index - Start < 3 && FChar::IsDigit(Text[Index]))
+			{
+				++Index;
+			}
+			return Index;
+		}
+
+		// Runs of symbols with at most one leading space, and the newlines straight after them: " {\"", "},\n"
+		if (IsSymbol(First) || (First == TEXT(' ') && Index < Len && IsSymbol(Text[Index])))
+		{
+			while (Index < Len && IsSymbol(Text[Index]))
+			{
+				++Index;
+			}
+			while (Index < Len && IsNewline(Text[Index]))
+			{
+				++Index;
+			}
+			return Index;
+		}
+
+		// Whitespace up to its last newline, otherwise all of it but the last space, which goes with the next word
+		int32 LastNewline = IsNewline(First) ? Start : INDEX_NONE;
+		while (Index < Len && FChar::IsWhitespace(Text[Index]))
+		{
+			if (IsNewline(Text[Index]))
+			{
+				LastNewline = Index;
+			}
+			++Index;
+		}
+		if (LastNewline != INDEX_NONE)
+		{
+			return LastNewline + 1;
+		}
+		return Index < Len && Index - Start > 1 ? Index - 1 : Index;
+	}
+}
+
+FChatTokenizer& FChatTokenizer::Get()
+{
+	static FChatTokenizer Instance;
+	return Instance;
+}
+
+FChatTokenizer::FChatTokenizer()
+	: PieceCounts(MaxCachedPieces)
+{
+}
+
+int32 FChatTokenizer::CountTokens(const FStringView Text)
+{
+	check(IsInGameThread());
+
+	if (!HasVocabulary())
+	{
+		return (Text.Len() + 3) / 4;
+	}
+
+	int32 Tokens = 0;
+	for (int32 Start = 0; Start < Text.Len();)
+	{
+		const int32 End = FindPieceEnd(Text, Start);
+		Tokens += CountPiece(Text.Mid(Start, End - Start));
+		Start = End;
+	}
+
+	Stats.Tokens += Tokens;
+	return Tokens;
+}
+
+int32 FChatTokenizer::CountTokens(const FChatMessage& Message)
+{
+	return CountTokens(Message.Role) + CountTokens(Message.Content) + TokensPerMessage;
+}
+
+int32 FChatTokenizer::CountTokens(const TConstArrayView<FChatMessage> Messages)
+{
+	int32 Tokens = TokensPerReply;
+	for (const FChatMessage& Message : Messages)
+	{
+		Tokens += CountTokens(Message);
+	}
+	return Tokens;
+}
+
+void FChatTokenizer::Encode(const FStringView Text, TArray<int32>& OutTokens)
+{
+	if (!HasVocabulary())
+	{
+		return;
+	}
+
+	for (int32 Start = 0; Start < Text.Len();)
+	{
+		const int32 End = FindPieceEnd(Text, Start);
+		const FTCHARToUTF8 Utf8(Text.GetData() + Start, End - Start);
+		const TConstArrayView<uint8> Bytes(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+		for (int32 ChunkStart = 0; ChunkStart < Bytes.Num(); ChunkStart += MaxPieceBytes)
+		{
+			MergeBytes(Bytes.Mid(ChunkStart, MaxPieceBytes), &OutTokens);
+		}
+		Start = End;
+	}
+}
+
+bool FChatTokenizer::HasVocabulary()
+{
+	LoadVocabulary();
+	return !Ranks.IsEmpty();
+}
+
+void FChatTokenizer::LogStats() const
+{
+	UE_LOG(LogTemp, Log, TEXT("FChatTokenizer: %s (%d tokens), %lld tokens counted in %lld pieces, %.1f%% of pieces from the cache."),
+		VocabularyName.IsEmpty() ? TEXT("no vocab, estimating") : *VocabularyName,
+		Ranks.Num(),
+		Stats.Tokens,
+		Stats.Pieces,
+		Stats.GetHitRate() * 100.0f);
+}
+
+void FChatTokenizer::LoadVocabulary()
+{
+	if (bVocabularyLoaded)
+	{
+		return;
+	}
+	bVocabularyLoaded = true;
+
+	const FString Directory = FPaths::ProjectContentDir() / TEXT("Tokenizer");
+	for (const TCHAR* FileName : VocabularyFiles)
+	{
+		const double LoadStartTime = FPlatformTime::Seconds();
+
+		TArray<FString> Lines;
+		if (!FFileHelper::LoadFileToStringArray(Lines, *(Directory / FileName)))
+		{
+			continue;
+		}
+
+		// One token per line: "<base64 of its bytes> <rank>"
+		Ranks.Reserve(Lines.Num());
+		TArray<uint8> TokenBytes;
+		for (const FString& Line : Lines)
+		{
+			int32 Space = INDEX_NONE;
+			TokenBytes.Reset();
+			if (!Line.FindChar(TEXT(' '), Space) || !FBase64::Decode(Line.Left(Space), TokenBytes))
+			{
+				continue;
+			}
+
+			Ranks.Add(CityHash64(reinterpret_cast<const char*>(TokenBytes.GetData()), TokenBytes.Num()), FCString::Atoi(*Line + Space + 1));
+			MaxTokenBytes = FMath::Max(MaxTokenBytes, TokenBytes.Num());
+		}
+
+		VocabularyName = FileName;
+		UE_LOG(LogTemp, Log, TEXT("FChatTokenizer::LoadVocabulary(): Loaded %d tokens from %s in %.3fs."), Ranks.Num(), FileName, FPlatformTime::Seconds() - LoadStartTime);
+		return;
+	}
+
+	UE_LOG(LogTemp, Warning, TEXT("FChatTokenizer::LoadVocabulary(): No vocab file in %s, prompt tokens are estimated at four characters a token."), *Directory);
+}
+
+int32 FChatTokenizer::CountPiece(const FStringView Piece)
+{
+	++Stats.Pieces;
+
+	const uint64 Key = CityHash64(reinterpret_cast<const char*>(Piece.GetData()), Piece.Len() * sizeof(TCHAR));
+	if (const int32* CachedCount = PieceCounts.FindAndTouch(Key))
+	{
+		++Stats.PieceCacheHits;
+		return *CachedCount;
+	}
+
+	const FTCHARToUTF8 Utf8(Piece.GetData(), Piece.Len());
+	const TConstArrayView<uint8> Bytes(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+
+	int32 Count = 0;
+	for (int32 ChunkStart = 0; ChunkStart < Bytes.Num(); ChunkStart += MaxPieceBytes)
+	{
+		Count += MergeBytes(Bytes.Mid(ChunkStart, MaxPieceBytes), nullptr);
+	}
+
+	PieceCounts.Add(Key, Count);
+	return Count;
+}
+
+int32 FChatTokenizer::MergeBytes(const TConstArrayView<uint8> Bytes, TArray<int32>* OutTokens) const
+{
+	// Most pieces are a single token
+	const int32 WholeRank = FindRank(Bytes.GetData(), Bytes.Num());
+	if (WholeRank != MAX_int32)
+	{
+		if (OutTokens)
+		{
+			OutTokens->Add(WholeRank);
+		}
+		return 1;
+	}
+
+	// Otherwise start from single bytes and keep merging the adjacent pair whose union has the lowest rank, as tiktoken does.
+	// Each part remembers the rank of itself merged with the part after it.
+	struct FPart
+	{
+		int32 Start;
+		int32 Rank;
+	};
+	TArray<FPart, TInlineAllocator<64>> Parts;
+	Parts.Reserve(Bytes.Num() + 1);
+	for (int32 Index = 0; Index <= Bytes.Num(); ++Index)
+	{
+		Parts.Add({ Index, MAX_int32 });
+	}
+
+	const auto PairRank = [this, &Bytes, &Parts](const int32 Index)
+	{
+		return Index + 2 < Parts.Num()
+			? FindRank(Bytes.GetData() + Parts[Index].Start, Parts[Index + 2].Start - Parts[Index].Start)
+			: MAX_int32;
+	};
+	for (int32 Index = 0; Index + 2 < Parts.Num(); ++Index)
+	{
+		Parts[Index].Rank = PairRank(Index);
+	}
+
+	while (Parts.Num() > 2)
+	{
+		int32 MinIndex = INDEX_NONE;
+		int32 MinRank = MAX_int32;
+		for (int32 Index = 0; Index + 2 < Parts.Num(); ++Index)
+		{
+			if (Parts[Index].Rank < MinRank)
+			{
+				MinRank = Parts[Index].Rank;
+				MinIndex = Index;
+			}
+		}
+		if (MinIndex == INDEX_NONE)
+		{
+			break;
+		}
+
+		// Only the pairs that start at the merged part and at the one before it have changed
+		Parts.RemoveAt(MinIndex + 1, 1, EAllowShrinking::No);
+		Parts[MinIndex].Rank = PairRank(MinIndex);
+		if (MinIndex > 0)
+		{
+			Parts[MinIndex - 1].Rank = PairRank(MinIndex - 1);
+		}
+	}
+
+	if (OutTokens)
+	{
+		for (int32 Index = 0; Index + 1 < Parts.Num(); ++Index)
+		{
+			OutTokens->Add(FindRank(Bytes.GetData() + Parts[Index].Start, Parts[Index + 1].Start - Parts[Index].Start));
+		}
+	}
+	return Parts.Num() - 1;
+}
+
+int32 FChatTokenizer::FindRank(const uint8* Bytes, const int32 Num) const
+{
+	if (Num > MaxTokenBytes)
+	{
+		return MAX_int32;
+	}
+
+	const int32* Rank = Ranks.Find(CityHash64(reinterpret_cast<const char*>(Bytes), Num));
+	return Rank ? *Rank : MAX_int32;
+}
\ No newline at end of file
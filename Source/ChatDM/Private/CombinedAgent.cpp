@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CombinedAgent.h"
+
+#include "ChatPromptLibrary.h"
+#include "CombinedTurnResult.h"
+#include "Dom/JsonObject.h"
+#include "RulesAgent.h"
+#include "Serialization/JsonSerializer.h"
+
+namespace
+{
+	/** Appended to the rules and narrator prompts when DT_Prompts has no dedicated combined prompt. */
+	const TCHAR* CombinedInstructions = TEXT(
+		"You are acting as BOTH the Rules Agent and the Narrator Agent described above, in a single reply.\n"
+		"First judge the PLAYERINPUT against the WORLDSTATE exactly as the Rules Agent would, then narrate the outcome exactly as the Narrator Agent would.\n"
+		"The narration must agree with the rules result and must not describe any state change that is not in the rules result.");
+
+	/** Only needed without structured outputs, the response schema already pins the reply down. */
+	const TCHAR* CombinedFormatInstructions = TEXT(
+		"\nRespond with ONLY a JSON object of the form:\n"
+		"{\"rules\": <the Rules Agent JSON object>, \"narration\": \"<the Narrator Agent text>\"}");
+}
+
+UCombinedAgent::UCombinedAgent()
+{
+	// Needs the narrator's story context, bounded the same way
+	ContextPolicy = EChatContextPolicy::TokenBudget;
+	MaxContextTokens = 12000;
+	ResponseStruct = FCombinedTurnResult::StaticStruct();
+
+	// One reply carries the verdict and the narration, a small model gets the pairing wrong too often
+	DefaultModelTier = 1;
+}
+
+void UCombinedAgent::Initialize(const FString& InPrompt)
+{
+	UE_LOG(LogTemp, Log, TEXT("UCombinedAgent::Initialize(): CombinedAgent initialized."));
+
+	// Prefer a prompt written for the combined mode, otherwise stitch one together from the two agents' prompts.
+	FString InitializePrompt;
+	if (!LoadPromptRow(TEXT("Combined_SystemMessage"), InitializePrompt))
+	{
+		FString RulesPrompt;
+		FString NarratorPrompt;
+		LoadPromptRow(TEXT("Rules_SystemMessage"), RulesPrompt);
+		LoadPromptRow(TEXT("Narrator_SystemMessage"), NarratorPrompt);
+
+		InitializePrompt = FString::Printf(
+			TEXT("RULES AGENT INSTRUCTIONS:\n%s\n\nNARRATOR AGENT INSTRUCTIONS:\n%s\n\n%s%s"),
+			*RulesPrompt,
+			*NarratorPrompt,
+			CombinedInstructions,
+			bUseStructuredOutputs ? TEXT("") : CombinedFormatInstructions);
+	}
+	UE_LOG(LogTemp, Verbose, TEXT("UCombinedAgent::Initialize(): Loaded Prompt: %s"), *InitializePrompt);
+
+	SystemMessage = FChatPromptLibrary::Get().MakeSystemMessage(InitializePrompt);
+	MessageLog.Push(SystemMessage);
+}
+
+void UCombinedAgent::SendMessage(const FString& PlayerInput, const FString& WorldStateJson)
+{
+	// Wrap the World State and Player Input into a single message.
+	const FString WrappedMessage = BuildWrappedUserMessage(WorldStateJson, PlayerInput);
+
+	// Update the message log with the new message
+	const FChatMessage NewMessage = FChatMessage("user", WrappedMessage, BuildHistoryUserMessage(PlayerInput));
+	AppendMessage(MessageLog, NewMessage);
+
+	// Pass a callback so we can handle the async response.
+	ActiveRequest = Super::SendMessage(MessageLog,
+		[this, PlayerInput](const FString& ResponseContent)
+		{
+			HandleResponse(ResponseContent, PlayerInput);
+		},
+		MakeTurnOptions(PlayerInput));
+}
+
+void UCombinedAgent::AbandonTurn()
+{
+	DropUnansweredMessage(MessageLog);
+}
+
+void UCombinedAgent::HandleResponse(const FString& ResponseContent, const FString& PlayerInput)
+{
+	UE_LOG(LogTemp, Log, TEXT("[CombinedAgent::HandleResponse] Response (Raw): %s"), *ResponseContent);
+
+	// Skip anything around the outer object (code fences, stray prose)
+	int32 JsonStart = INDEX_NONE;
+	int32 JsonEnd = INDEX_NONE;
+	ResponseContent.FindChar(TEXT('{'), JsonStart);
+	ResponseContent.FindLastChar(TEXT('}'), JsonEnd);
+	if (JsonStart == INDEX_NONE || JsonEnd < JsonStart)
+	{
+		UE_LOG(LogTemp, Error, TEXT("[CombinedAgent::HandleResponse] No JSON object found in response."));
+		HandleRequestFailed(PlayerInput);
+		return;
+	}
+
+	TSharedPtr<FJsonObject> RootObj;
+	const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(ResponseContent.Mid(JsonStart, JsonEnd - JsonStart + 1));
+	if (!FJsonSerializer::Deserialize(Reader, RootObj) || !RootObj.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("[CombinedAgent::HandleResponse] Failed to parse response into root object."));
+		HandleRequestFailed(PlayerInput);
+		return;
+	}
+
+	const TSharedPtr<FJsonObject>* RulesObj;
+	FString Narration;
+	if (!RootObj->TryGetObjectField(TEXT("rules"), RulesObj) || !RootObj->TryGetStringField(TEXT("narration"), Narration))
+	{
+		UE_LOG(LogTemp, Error, TEXT("[CombinedAgent::HandleResponse] Response is missing the 'rules' object or the 'narration' string."));
+		HandleRequestFailed(PlayerInput);
+		return;
+	}
+
+	// Run the rules half through the same conversion the Rules Agent uses
+	FString RulesJson;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&RulesJson);
+	FJsonSerializer::Serialize(RulesObj->ToSharedRef(), Writer);
+
+	FString RulesResultJson;
+	FRulesUpdate RulesWorldStateUpdate;
+	if (!URulesAgent::JsonToRulesUpdate(RulesJson, RulesWorldStateUpdate, RulesResultJson))
+	{
+		UE_LOG(LogTemp, Error, TEXT("[CombinedAgent::HandleResponse] The 'rules' object holds no rules result."));
+		HandleRequestFailed(PlayerInput);
+		return;
+	}
+
+	// Keep the reply in our history so the model sees its own format on later turns. Unusable replies never get here,
+	// they fail the turn like a request that got no answer, which takes our unanswered message back out too.
+	AppendMessage(MessageLog, FChatMessage("assistant", ResponseContent));
+
+	UE_LOG(LogTemp, Warning, TEXT("[CombinedAgent::HandleResponse] Player action bSuccess=%s"), RulesWorldStateUpdate.bSuccess ? TEXT("true") : TEXT("false"));
+
+	if (OnCombinedResultReady.IsBound())
+	{
+		OnCombinedResultReady.Broadcast(RulesWorldStateUpdate, RulesResultJson, Narration, PlayerInput);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,223 @@
+#include "LocalRulesEvaluator.h"
+
+#include "Algo/Find.h"
+
+namespace
+{
+	/** Statuses that mean an enemy can no longer react to what the player does. */
+	bool IsEnemyActive(const FEnemy& Enemy)
+	{
+		return Enemy.Health > 0
+			&& !Enemy.Status.Equals(TEXT("Incapacitated"), ESearchCase::IgnoreCase)
+			&& !Enemy.Status.Equals(TEXT("Dead"), ESearchCase::IgnoreCase)
+			&& !Enemy.Status.Equals(TEXT("Defeated"), ESearchCase::IgnoreCase);
+	}
+
+	/** Lowercase words of the input with punctuation and filler words dropped. */
+	TArray<FString> Tokenize(const FString& PlayerInput)
+	{
+		static const TCHAR* FillerWords[] = { TEXT("the"), TEXT("a"), TEXT("an"), TEXT("my"), TEXT("to"), TEXT("i") };
+
+		FString Cleaned = PlayerInput.ToLower();
+		for (TCHAR& Char : Cleaned)
+		{
+			if (!FChar::IsAlnum(Char) && Char != TEXT('\''))
+			{
+				Char = TEXT(' ');
+			}
+		}
+
+		TArray<FString> Words;
+		Cleaned.ParseIntoArrayWS(Words);
+		Words.RemoveAll([](const FString& Word)
+		{
+			return Algo::FindByPredicate(FillerWords, [&Word](const TCHAR* Filler) { return Word == Filler; }) != nullptr;
+		});
+		return Words;
+	}
+
+	/** Strip a leading verb (one or two words) and return the rest as the object phrase. */
+	bool MatchVerb(const TArray<FString>& Words, const TArrayView<const TCHAR* const> Verbs, FString& OutObject)
+	{
+		for (const TCHAR* Verb : Verbs)
+		{
+			TArray<FString> VerbWords;
+			FString(Verb).ParseIntoArrayWS(VerbWords);
+			if (Words.Num() <= VerbWords.Num())
+			{
+				continue;
+			}
+
+			bool bMatches = true;
+			for (int32 Index = 0; Index < VerbWords.Num() && bMatches; ++Index)
+			{
+				bMatches = Words[Index] == VerbWords[Index];
+			}
+			if (bMatches)
+			{
+				OutObject = FString::Join(TArrayView<const FString>(Words).RightChop(VerbWords.Num()), TEXT(" "));
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/** Find the one item the phrase names, either exactly or by its last words ("potion" for "Healing Potion"). */
+	int32 FindItem(const TArray<FString>& Items, const FString& Phrase)
+	{
+		int32 Found = INDEX_NONE;
+		for (int32 Index = 0; Index < Items.Num(); ++Index)
+		{
+			if (Items[Index].Equals(Phrase, ESearchCase::IgnoreCase))
+			{
+				return Index;
+			}
+			if (Items[Index].EndsWith(TEXT(" ") + Phrase, ESearchCase::IgnoreCase))
+			{
+				if (Found != INDEX_NONE)
+				{
+					// Ambiguous, let the Rules Agent sort it out
+					return INDEX_NONE;
+				}
+				Found = Index;
+			}
+		}
+		return Found;
+	}
+
+	/** Expand single-letter direction shorthands. */
+	FString NormalizeDirection(const FString& Direction)
+	{
+		static const TMap<FString, FString> Shorthands = {
+			{ TEXT("n"), TEXT("north") }, { TEXT("s"), TEXT("south") }, { TEXT("e"), TEXT("east") },
+			{ TEXT("w"), TEXT("west") }, { TEXT("u"), TEXT("up") }, { TEXT("d"), TEXT("down") } };
+
+		const FString* Expanded = Shorthands.Find(Direction);
+		return Expanded ? *Expanded : Direction;
+	}
+
+	bool IsDirection(const FString& Word)
+	{
+		static const TSet<FString> Directions = { TEXT("north"), TEXT("south"), TEXT("east"), TEXT("west"), TEXT("up"), TEXT("down") };
+		return Directions.Contains(Word);
+	}
+
+	/** An update that changes nothing, which every local verdict starts from. */
+	FRulesUpdate MakeUnchangedUpdate(const FWorldState& State, const bool bSuccess, const FString& Reason)
+	{
+		FRulesUpdate Update = FRulesUpdate();
+		Update.bSuccess = bSuccess;
+		Update.Reason = Reason;
+		Update.StateChanges.CurrentRoomIndex = State.CurrentRoomIndex;
+		Update.StateChanges.bHasCurrentRoomIndex = true;
+		return Update;
+	}
+}
+
+bool FLocalRulesEvaluator::TryEvaluate(const FString& PlayerInput, const FWorldState& State, FRulesUpdate& OutRulesUpdate)
+{
+	const FRoom* CurrentRoom = State.FindRoom(State.CurrentRoomIndex);
+	if (!CurrentRoom)
+	{
+		return false;
+	}
+	const FRoom& Room = *CurrentRoom;
+
+	// Anyone in the room who can react makes even a trivial action a judgement call
+	if (Room.Enemies.ContainsByPredicate(IsEnemyActive))
+	{
+		return false;
+	}
+
+	const TArray<FString> Words = Tokenize(PlayerInput);
+	if (Words.IsEmpty())
+	{
+		return false;
+	}
+
+	static const TCHAR* const TakeVerbs[] = { TEXT("pick up"), TEXT("take"), TEXT("grab"), TEXT("get") };
+	static const TCHAR* const GoVerbs[] = { TEXT("go"), TEXT("walk"), TEXT("move"), TEXT("head"), TEXT("run") };
+	static const TCHAR* const DrinkVerbs[] = { TEXT("drink"), TEXT("quaff"), TEXT("use") };
+
+	FString Object;
+
+	// Taking an item lying in the room
+	if (MatchVerb(Words, TakeVerbs, Object))
+	{
+		const int32 ItemIndex = FindItem(Room.Items, Object);
+		if (ItemIndex == INDEX_NONE)
+		{
+			return false;
+		}
+
+		const FString& Item = Room.Items[ItemIndex];
+		OutRulesUpdate = MakeUnchangedUpdate(State, true, FString::Printf(TEXT("The %s is in the room and nothing stops the player from taking it."), *Item));
+		OutRulesUpdate.ItemsPickedUp.Add(Item);
+
+		FRoomUpdate& RoomUpdate = OutRulesUpdate.StateChanges.Rooms.Emplace_GetRef();
+		RoomUpdate.RoomIndex = Room.RoomIndex;
+		RoomUpdate.Items = Room.Items;
+		RoomUpdate.Items.RemoveAt(ItemIndex);
+
+		OutRulesUpdate.StateChanges.PlayerHeldItems = State.PlayerHeldItems;
+		OutRulesUpdate.StateChanges.PlayerHeldItems.Add(Item);
+		return true;
+	}
+
+	// Moving through an exit, "go north" or just "north"
+	FString Direction;
+	if (Words.Num() == 1 && IsDirection(NormalizeDirection(Words[0])))
+	{
+		Direction = NormalizeDirection(Words[0]);
+	}
+	else if (MatchVerb(Words, GoVerbs, Object) && IsDirection(NormalizeDirection(Object)))
+	{
+		Direction = NormalizeDirection(Object);
+	}
+
+	if (!Direction.IsEmpty())
+	{
+		// Names compare without case, and a direction that was never interned can't be an exit.
+		// Not being a listed exit doesn't make it impossible (stairs, a hole in the floor), that's the Rules Agent's call.
+		const FName DirectionName(*Direction, FNAME_Find);
+		const int32 ExitIndex = DirectionName.IsNone() ? INDEX_NONE : Room.Exits.IndexOfByKey(DirectionName);
+		if (ExitIndex == INDEX_NONE)
+		{
+			return false;
+		}
+
+		// Without a known destination only the Rules Agent can say where the exit leads
+		const int32 Destination = Room.ExitRoomIndices.IsValidIndex(ExitIndex) ? Room.ExitRoomIndices[ExitIndex] : INDEX_NONE;
+		if (!State.FindRoom(Destination))
+		{
+			return false;
+		}
+
+		OutRulesUpdate = MakeUnchangedUpdate(State, true, FString::Printf(TEXT("The player leaves through the %s exit."), *Room.Exits[ExitIndex].ToString()));
+		OutRulesUpdate.StateChanges.CurrentRoomIndex = Destination;
+		return true;
+	}
+
+	// Drinking a potion the player is carrying
+	if (MatchVerb(Words, DrinkVerbs, Object))
+	{
+		const int32 ItemIndex = FindItem(State.PlayerHeldItems, Object);
+		if (ItemIndex == INDEX_NONE || !State.PlayerHeldItems[ItemIndex].Contains(TEXT("Potion")))
+		{
+			return false;
+		}
+
+		// An empty inventory update reads as "no change", so the last item has to go through the Rules Agent
+		if (State.PlayerHeldItems.Num() == 1)
+		{
+			return false;
+		}
+
+		OutRulesUpdate = MakeUnchangedUpdate(State, true, FString::Printf(TEXT("The player drinks the %s."), *State.PlayerHeldItems[ItemIndex]));
+		OutRulesUpdate.StateChanges.PlayerHeldItems = State.PlayerHeldItems;
+		OutRulesUpdate.StateChanges.PlayerHeldItems.RemoveAt(ItemIndex);
+		return true;
+	}
+
+	return false;
+}
\ No newline at end of file
@@ -2,48 +2,38 @@
 
 #include "NarratorAgent.h"
 
-#include "ChatDM/Public/ChatPromptRow.h"
+#include "ChatPromptLibrary.h"
+
+UNarratorAgent::UNarratorAgent()
+{
+	// Narration benefits from story context, but only as much as we can afford to resend every turn
+	ContextPolicy = EChatContextPolicy::TokenBudget;
+	MaxContextTokens = 12000;
+
+	// Narration is what the player reads, so it gets the capable model unless the turn is running late
+	ModelTiers[0].MaxTokens = 600;
+	ModelTiers[1].MaxTokens = 600;
+	DefaultModelTier = 1;
+}
 
 void UNarratorAgent::Initialize(const FString& InPrompt)
 {
 	UE_LOG(LogTemp, Log, TEXT("UNarratorAgent::Initialize(): NarratorAgent initialized."));
 
-	// Get a reference to the prompts DT
-	static const FString DataTablePath = TEXT("/Game/Assets/DT_Prompts.DT_Prompts");
-	UDataTable* DataTable = Cast<UDataTable>(StaticLoadObject(UDataTable::StaticClass(), nullptr, *DataTablePath));
-	if (!DataTable)
+	// Pull the system message prompt from the DT
+	FString InitializePrompt;
+	if (!LoadPromptRow(TEXT("Narrator_SystemMessage"), InitializePrompt))
 	{
-		UE_LOG(LogTemp, Error, TEXT("UNarratorAgent::Initialize(): Failed to load DataTable at %s"), *DataTablePath);
 		return;
 	}
-
-	// Get the initialize row from the DT
-	FName RowName = TEXT("Narrator_SystemMessage");
-	FChatPromptRow* Row = DataTable->FindRow<FChatPromptRow>(RowName, TEXT("UNarratorAgent::Initialize"), true);
-	if (!Row)
-	{
-		UE_LOG(LogTemp, Error, TEXT("UNarratorAgent::Initialize(): Row %s not found in DataTable."), *RowName.ToString());
-		return;
-	}
-
-	// Pull out the system message prompt
-	const FString InitializePrompt = Row->PromptText;
-	UE_LOG(LogTemp, Log, TEXT("UNarratorAgent::Initialize(): Loaded Prompt: %s"), *InitializePrompt);
+	UE_LOG(LogTemp, Verbose, TEXT("UNarratorAgent::Initialize(): Loaded Prompt: %s"), *InitializePrompt);
 
 	// Call parent to finish initialization with the  system message
-	SystemMessage = FChatMessage("system", InitializePrompt);
+	SystemMessage = FChatPromptLibrary::Get().MakeSystemMessage(InitializePrompt);
 	MessageLog.Push(SystemMessage);
 
 	// Also get the startup prompt for the initial message from the DT
-	RowName = TEXT("Narrator_StartupPrompt");
-	Row = DataTable->FindRow<FChatPromptRow>(RowName, TEXT("UNarratorAgent::SendInitialMessage"), true);
-	if (!Row)
-	{
-		UE_LOG(LogTemp, Error, TEXT("UNarratorAgent::Initialize(): Row %s not found in DataTable."), *RowName.ToString());
-		return;
-	}
-
-	StartupPrompt = Row->PromptText;
+	LoadPromptRow(TEXT("Narrator_StartupPrompt"), StartupPrompt);
 }
 
 void UNarratorAgent::SendInitialMessage(const FString& CurrentWorldStateJson)
@@ -57,32 +47,188 @@ void UNarratorAgent::SendInitialMessage(const FString& CurrentWorldStateJson)
 	const FString WrappedMessage = BuildWrappedUserMessage(CurrentWorldStateJson, StartupPrompt);
 	
 	// Update the message log with the new message
-	const FChatMessage NewMessage = FChatMessage("user", WrappedMessage);
-	MessageLog.Push(NewMessage);
+	const FChatMessage NewMessage = FChatMessage("user", WrappedMessage, BuildHistoryUserMessage(StartupPrompt));
+	AppendMessage(MessageLog, NewMessage);
+	bTurnInFlight = true;
+
+	// The opening narration for a given starting world is the same every session, so it only ever needs asking for once
+	FChatRequestOptions Options = MakeRequestOptions(StartupPrompt);
+	Options.bUseCache = true;
 
 	// Call the parent to actually send the message to AI
-	Super::SendMessage(MessageLog,
+	ActiveRequest = Super::SendMessage(MessageLog,
 		[this](const FString& ResponseContent)
 		{
 			HandleResponse(ResponseContent, StartupPrompt);
-		});
+		},
+		Options);
 }
 
-void UNarratorAgent::SendMessage(const FString& PlayerInput, const FString& CurrentWorldStateJson, const FString& RulesResultJson)
+void UNarratorAgent::SendMessage(const FString& PlayerInput, const FString& CurrentWorldStateJson, const FString& RulesResultJson, const float LatencyBudgetSeconds)
 {
 	// Wrap the World State and Player Input into a single message.
 	const FString WrappedMessage = BuildWrappedUserMessage(CurrentWorldStateJson, RulesResultJson, PlayerInput);
 	
 	// Update the message log with the new message
-	const FChatMessage NewMessage = FChatMessage("user", WrappedMessage);
-	MessageLog.Push(NewMessage);
+	const FChatMessage NewMessage = FChatMessage("user", WrappedMessage, BuildHistoryUserMessage(RulesResultJson, PlayerInput));
+	AppendMessage(MessageLog, NewMessage);
+	bTurnInFlight = true;
+
+	FChatRequestOptions Options = MakeRequestOptions(PlayerInput);
+	Options.LatencyBudgetSeconds = LatencyBudgetSeconds;
 
 	// Call the parent to actually send the message to AI
-	Super::SendMessage(MessageLog,
+	ActiveRequest = Super::SendMessage(MessageLog,
 		[this, PlayerInput](const FString& ResponseContent)
 		{
 			HandleResponse(ResponseContent, PlayerInput);
-		});
+		},
+		Options);
+}
+
+void UNarratorAgent::SendSpeculativeMessage(const FString& PlayerInput, const FString& PredictedWorldStateJson, const FString& PredictedRulesResultJson)
+{
+	CancelSpeculation();
+
+	bTurnInFlight = true;
+
+	FSpeculativeTurn& Turn = Speculation.Emplace();
+	Turn.PlayerInput = PlayerInput;
+	Turn.WorldStateJson = PredictedWorldStateJson;
+	Turn.UserMessage = FChatMessage("user",
+		BuildWrappedUserMessage(PredictedWorldStateJson, PredictedRulesResultJson, PlayerInput),
+		BuildHistoryUserMessage(PredictedRulesResultJson, PlayerInput));
+
+	// Send against a scratch copy of the log, the real one only changes if the prediction is committed
+	TArray<FChatMessage> SpeculativeLog = MessageLog;
+	AppendMessage(SpeculativeLog, Turn.UserMessage);
+
+	// Hold streamed text back until we know the prediction was right
+	FChatRequestOptions Options;
+	Options.bStream = bStreamResponses;
+	Options.Priority = EChatRequestPriority::Speculative;
+	Options.OnErrorCallback = [this]()
+	{
+		if (!Speculation.IsSet())
+		{
+			return;
+		}
+
+		// Uncommitted, the manager just narrates normally once the rules land. Committed, the turn has nothing else coming.
+		const bool bCommitted = Speculation->bCommitted;
+		const FString PlayerInput = Speculation->PlayerInput;
+		Speculation.Reset();
+		bTurnInFlight = false;
+
+		if (bCommitted && OnRequestFailed.IsBound())
+		{
+			OnRequestFailed.Broadcast(PlayerInput);
+		}
+	};
+	if (bStreamResponses)
+	{
+		Options.OnDeltaCallback = [this](const FString& Delta)
+		{
+			if (!Speculation.IsSet())
+			{
+				return;
+			}
+
+			if (Speculation->bCommitted)
+			{
+				OnNarratorChunkReceived.Broadcast(Delta, Speculation->StreamedText.IsEmpty());
+			}
+			Speculation->StreamedText += Delta;
+		};
+	}
+
+	Turn.Request = Super::SendMessage(SpeculativeLog,
+		[this](const FString& ResponseContent)
+		{
+			if (!Speculation.IsSet())
+			{
+				return;
+			}
+
+			Speculation->Response = ResponseContent;
+			Speculation->bResponseReady = true;
+			FinishSpeculation();
+		},
+		Options);
+}
+
+void UNarratorAgent::CommitSpeculation(const FString& RulesResultJson)
+{
+	if (!Speculation.IsSet() || Speculation->bCommitted)
+	{
+		return;
+	}
+
+	Speculation->bCommitted = true;
+
+	// The history keeps the verdict the Rules Agent actually gave, not the guess the narration was written against
+	Speculation->UserMessage = FChatMessage("user",
+		BuildWrappedUserMessage(Speculation->WorldStateJson, RulesResultJson, Speculation->PlayerInput),
+		BuildHistoryUserMessage(RulesResultJson, Speculation->PlayerInput));
+
+	// Flush whatever streamed in while we were waiting on the rules result
+	if (!Speculation->StreamedText.IsEmpty() && !Speculation->bResponseReady)
+	{
+		OnNarratorChunkReceived.Broadcast(Speculation->StreamedText, true);
+	}
+
+	FinishSpeculation();
+}
+
+void UNarratorAgent::CancelSpeculation()
+{
+	if (!Speculation.IsSet())
+	{
+		return;
+	}
+
+	if (Speculation->Request.IsValid())
+	{
+		Speculation->Request->Cancel();
+	}
+	Speculation.Reset();
+
+	// Nothing of the turn reached the log, the real request (if any) sets this again
+	bTurnInFlight = false;
+}
+
+void UNarratorAgent::CancelRequests()
+{
+	CancelSpeculation();
+
+	if (SummaryRequest.IsValid())
+	{
+		SummaryRequest->Cancel();
+		SummaryRequest.Reset();
+	}
+
+	Super::CancelRequests();
+}
+
+void UNarratorAgent::AbandonTurn()
+{
+	DropUnansweredMessage(MessageLog);
+	bTurnInFlight = false;
+}
+
+void UNarratorAgent::FinishSpeculation()
+{
+	if (!Speculation.IsSet() || !Speculation->bCommitted || !Speculation->bResponseReady)
+	{
+		return;
+	}
+
+	// Move out first, HandleResponse broadcasts and listeners may start the next turn
+	const FSpeculativeTurn Turn = MoveTemp(Speculation.GetValue());
+	Speculation.Reset();
+
+	AppendMessage(MessageLog, Turn.UserMessage);
+	HandleResponse(Turn.Response, Turn.PlayerInput);
 }
 
 void UNarratorAgent::HandleResponse(const FString& ResponseContent, const FString& PlayerInput)
@@ -91,8 +237,173 @@ void UNarratorAgent::HandleResponse(const FString& ResponseContent, const FStrin
 
 	// TODO: Actually process the response...
 
+	// Keep the narration in our history so the next turn has context. Streamed responses only reach
+	// here once, with the fully assembled text, so this never records partial chunks.
+	AppendMessage(MessageLog, FChatMessage("assistant", ResponseContent));
+
+	// The turn is complete, so this is the one safe point to swap a finished summary in
+	bTurnInFlight = false;
+	ApplyPendingSummary();
+
 	if (OnNarratorResultReady.IsBound())
 	{
 		OnNarratorResultReady.Broadcast(ResponseContent, PlayerInput);
 	}
+
+	// The player is reading and typing now, use that time to compact old turns
+	MaybeSummarizeHistory();
+}
+
+FChatRequestOptions UNarratorAgent::MakeRequestOptions(const FString& PlayerInput)
+{
+	FChatRequestOptions Options = MakeTurnOptions(PlayerInput);
+	Options.bStream = bStreamResponses;
+
+	if (bStreamResponses)
+	{
+		// Shared between deltas of the same response so listeners know when a new message starts
+		TSharedRef<bool> bIsFirstChunk = MakeShared<bool>(true);
+		Options.OnDeltaCallback = [this, bIsFirstChunk](const FString& Delta)
+		{
+			OnNarratorChunkReceived.Broadcast(Delta, *bIsFirstChunk);
+			*bIsFirstChunk = false;
+		};
+	}
+
+	return Options;
+}
+
+void UNarratorAgent::MaybeSummarizeHistory()
+{
+	if (!bSummarizeHistory || bTurnInFlight || SummaryRequest.IsValid() || PendingSummary.IsSet() || MessageLog.Num() < 2)
+	{
+		return;
+	}
+
+	int32 HistoryTokens = 0;
+	for (const FChatMessage& Message : MessageLog)
+	{
+		HistoryTokens += EstimateTokens(Message);
+	}
+	if (HistoryTokens < SummarizeThresholdTokens)
+	{
+		return;
+	}
+
+	// Find where the turns we keep verbatim begin, everything between the system prompt and there gets summarized.
+	// Index 0 is the system prompt; a previous summary (if any) sits at index 1 and is folded into the new one.
+	int32 KeepFrom = MessageLog.Num();
+	int32 TurnsKept = 0;
+	for (int32 Index = MessageLog.Num() - 1; Index >= 1 && TurnsKept < SummaryKeepRecentTurns; --Index)
+	{
+		if (MessageLog[Index].Role == TEXT("user"))
+		{
+			KeepFrom = Index;
+			++TurnsKept;
+		}
+	}
+
+	const int32 NumMessages = KeepFrom - 1;
+	if (NumMessages < 2)
+	{
+		return;
+	}
+
+	// Flatten the old turns into a transcript for the summarizer
+	FString Transcript;
+	for (int32 Index = 1; Index < KeepFrom; ++Index)
+	{
+		const FChatMessage& Message = MessageLog[Index];
+		const TCHAR* Speaker = Message.Role == TEXT("user") ? TEXT("PLAYER TURN") : Message.Role == TEXT("assistant") ? TEXT("NARRATOR") : TEXT("STORY SO FAR");
+		Transcript += FString::Printf(TEXT("%s:\n%s\n\n"), Speaker, *Message.Content);
+	}
+
+	TArray<FChatMessage> SummaryLog;
+	SummaryLog.Push(FChatMessage("system", TEXT(
+		"You compress the history of a text adventure for the game's narrator. "
+		"Summarize the transcript into a concise 'story so far' in past tense: where the player has been, what they did, "
+		"what they picked up or used, who they met or fought and how that ended, and any open threads. "
+		"Leave out the raw world state data, it is resent every turn. Respond with the summary only.")));
+	SummaryLog.Push(FChatMessage("user", Transcript));
+
+	const uint32 SourceHash = HashHistoryPrefix(NumMessages);
+
+	FChatRequestOptions Options;
+	Options.Model = SummaryModel;
+	Options.bIncludeWorldStateLegend = false;
+	Options.Priority = EChatRequestPriority::Background;
+	Options.OnErrorCallback = [this]()
+	{
+		// Try again after a later turn
+		SummaryRequest.Reset();
+	};
+
+	UE_LOG(LogTemp, Log, TEXT("UNarratorAgent::MaybeSummarizeHistory(): Summarizing %d messages (~%d history tokens)."), NumMessages, HistoryTokens);
+
+	SummaryRequest = Super::SendMessage(SummaryLog,
+		[this, NumMessages, SourceHash](const FString& ResponseContent)
+		{
+			SummaryRequest.Reset();
+
+			FPendingSummary& Summary = PendingSummary.Emplace();
+			Summary.NumMessages = NumMessages;
+			Summary.SourceHash = SourceHash;
+			Summary.Summary = ResponseContent.TrimStartAndEnd();
+
+			// Between turns we can swap right away, otherwise HandleResponse does it once the turn lands
+			if (!bTurnInFlight)
+			{
+				ApplyPendingSummary();
+			}
+		},
+		Options);
+}
+
+void UNarratorAgent::ApplyPendingSummary()
+{
+	if (!PendingSummary.IsSet())
+	{
+		return;
+	}
+
+	const FPendingSummary Summary = MoveTemp(PendingSummary.GetValue());
+	PendingSummary.Reset();
+
+	// If the context policy trimmed the log since, the summary no longer lines up with it
+	if (Summary.Summary.IsEmpty() || MessageLog.Num() <= Summary.NumMessages || HashHistoryPrefix(Summary.NumMessages) != Summary.SourceHash)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UNarratorAgent::ApplyPendingSummary(): Message log changed while summarizing, discarding summary."));
+		return;
+	}
+
+	int32 TokensBefore = 0;
+	for (const FChatMessage& Message : MessageLog)
+	{
+		TokensBefore += EstimateTokens(Message);
+	}
+
+	// Replace the summarized range with a single pinned system message in one step
+	MessageLog.RemoveAt(1, Summary.NumMessages, EAllowShrinking::No);
+	MessageLog.Insert(FChatMessage("system", FString::Printf(TEXT("STORY SO FAR:\n%s"), *Summary.Summary)), 1);
+
+	int32 TokensAfter = 0;
+	for (const FChatMessage& Message : MessageLog)
+	{
+		TokensAfter += EstimateTokens(Message);
+	}
+
+	LastSummaryTokensBefore = TokensBefore;
+	LastSummaryTokensAfter = TokensAfter;
+	UE_LOG(LogTemp, Log, TEXT("UNarratorAgent::ApplyPendingSummary(): Swapped in summary of %d messages, history ~%d -> ~%d tokens."), Summary.NumMessages, TokensBefore, TokensAfter);
+}
+
+uint32 UNarratorAgent::HashHistoryPrefix(const int32 NumMessages) const
+{
+	uint32 Hash = 0;
+	for (int32 Index = 1; Index <= NumMessages && Index < MessageLog.Num(); ++Index)
+	{
+		Hash = HashCombine(Hash, GetTypeHash(MessageLog[Index].Role));
+		Hash = HashCombine(Hash, GetTypeHash(MessageLog[Index].Content));
+	}
+	return Hash;
 }
\ No newline at end of file
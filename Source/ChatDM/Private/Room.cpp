@@ -0,0 +1,28 @@
+#include "Room.h"
+
+const FEnemy* FRoom::FindEnemy(const FName EnemyName) const
+{
+	const int32* Slot = EnemySlots.Find(EnemyName);
+	if (Slot && Enemies.IsValidIndex(*Slot) && Enemies[*Slot].Name == EnemyName)
+	{
+		return &Enemies[*Slot];
+	}
+
+	// A miss can be trusted when every enemy is indexed, anything else means Enemies changed behind the index's back
+	if (!Slot && EnemySlots.Num() == Enemies.Num())
+	{
+		return nullptr;
+	}
+	return Enemies.FindByPredicate([EnemyName](const FEnemy& Enemy) { return Enemy.Name == EnemyName; });
+}
+
+void FRoom::BuildIndexes()
+{
+	EnemySlots.Reset();
+	EnemySlots.Reserve(Enemies.Num());
+	for (int32 Slot = 0; Slot < Enemies.Num(); ++Slot)
+	{
+		// Keep the first of any enemies sharing a name, same as a front to back search would find
+		EnemySlots.FindOrAdd(Enemies[Slot].Name, Slot);
+	}
+}
\ No newline at end of file
@@ -2,41 +2,42 @@
 
 #include "RulesAgent.h"
 
-#include "ChatDM/Public/ChatPromptRow.h"
+#include "ChatPromptLibrary.h"
 #include "Enemy.h"
-#include "JsonObjectConverter.h"
 #include "Room.h"
 #include "RulesUpdate.h"
+#include "RulesUpdateDecoder.h"
 #include "WorldState.h"
 
+URulesAgent::URulesAgent()
+{
+	// The world state in each message already carries everything the rules need, so history only costs tokens
+	ContextPolicy = EChatContextPolicy::Stateless;
+	ResponseStruct = FRulesUpdate::StaticStruct();
+
+	// Rules replies are short, so a duplicate request is cheap next to a slow turn
+	RetryPolicy.bHedgeRequests = true;
+
+	// A short structured verdict doesn't need the flagship model, only replies the small one gets wrong go up a tier
+	ModelTiers[0].MaxTokens = 1024;
+	ModelTiers[1].MaxTokens = 1024;
+	DefaultModelTier = 0;
+}
+
 void URulesAgent::Initialize(const FString& InPrompt)
 {
 	UE_LOG(LogTemp, Log, TEXT("URulesAgent::Initialize(): RulesAgent initialized."));
 
-	// Get a reference to the prompts DT
-	static const FString DataTablePath = TEXT("/Game/Assets/DT_Prompts.DT_Prompts");
-	UDataTable* DataTable = Cast<UDataTable>(StaticLoadObject(UDataTable::StaticClass(), nullptr, *DataTablePath));
-	if (!DataTable)
+	// Pull the system message prompt from the DT
+	FString InitializePrompt;
+	if (!LoadPromptRow(TEXT("Rules_SystemMessage"), InitializePrompt))
 	{
-		UE_LOG(LogTemp, Error, TEXT("URulesAgent::Initialize(): Failed to load DataTable at %s"), *DataTablePath);
 		return;
 	}
-
-	// Get the initialize row from the DT
-	const FName RowName = TEXT("Rules_SystemMessage");
-	const FChatPromptRow* Row = DataTable->FindRow<FChatPromptRow>(RowName, TEXT("URulesAgent::Initialize"), true);
-	if (!Row)
-	{
-		UE_LOG(LogTemp, Error, TEXT("URulesAgent::Initialize(): Row %s not found in DataTable."), *RowName.ToString());
-		return;
-	}
-
-	// Pull out the system message prompt
-	const FString InitializePrompt = Row->PromptText;
-	UE_LOG(LogTemp, Log, TEXT("URulesAgent::Initialize(): Loaded Prompt: %s"), *InitializePrompt);
+	UE_LOG(LogTemp, Verbose, TEXT("URulesAgent::Initialize(): Loaded Prompt: %s"), *InitializePrompt);
 	
 	// Call parent to finish initialization with the  system message
-	SystemMessage = FChatMessage("system", InitializePrompt);
+	SystemMessage = FChatPromptLibrary::Get().MakeSystemMessage(InitializePrompt);
 	MessageLog.Push(SystemMessage);
 }
 
@@ -46,15 +47,31 @@ void URulesAgent::SendMessage(const FString& PlayerInput, const FString& WorldSt
 	const FString WrappedMessage = BuildWrappedUserMessage(WorldStateJson, PlayerInput);
 	
 	// Update the message log with the new message
-	const FChatMessage NewMessage = FChatMessage("user", WrappedMessage);
-	MessageLog.Push(NewMessage);
+	const FChatMessage NewMessage = FChatMessage("user", WrappedMessage, BuildHistoryUserMessage(PlayerInput));
+	AppendMessage(MessageLog, NewMessage);
+
+	SendTurn(PlayerInput, DefaultModelTier);
+}
+
+void URulesAgent::SendTurn(const FString& PlayerInput, const int32 ModelTier)
+{
+	ActiveModelTier = ModelTier;
+
+	FChatRequestOptions Options = MakeTurnOptions(PlayerInput);
+	Options.ModelTier = ModelTier;
 
 	// Pass a callback so we can handle the async response.
-	Super::SendMessage(MessageLog,
+	ActiveRequest = Super::SendMessage(MessageLog,
 		[this, PlayerInput](const FString& ResponseContent)
 		{
 			HandleResponse(ResponseContent, PlayerInput);
-		});
+		},
+		Options);
+}
+
+void URulesAgent::AbandonTurn()
+{
+	DropUnansweredMessage(MessageLog);
 }
 
 void URulesAgent::HandleResponse(const FString& ResponseContent, const FString& PlayerInput)
@@ -63,7 +80,24 @@ void URulesAgent::HandleResponse(const FString& ResponseContent, const FString&
 
 	FString RulesResultJson;
 	FRulesUpdate RulesWorldStateUpdate;
-	JsonToRulesUpdate(ResponseContent, RulesWorldStateUpdate, RulesResultJson);
+	bool bTruncated = false;
+	const bool bDecoded = JsonToRulesUpdate(ResponseContent, RulesWorldStateUpdate, RulesResultJson, &bTruncated);
+
+	// A reply that ran into max_tokens may have lost members after the ones that arrived, so it counts as unreadable while there's a bigger model to ask
+	if ((!bDecoded || bTruncated) && ModelTiers.IsValidIndex(ActiveModelTier + 1))
+	{
+		// The unanswered message is still the newest in the log, ask a more capable model instead of narrating garbage
+		UE_LOG(LogTemp, Warning, TEXT("[RulesAgent::HandleResponse] %s verdict, escalating to %s."), bDecoded ? TEXT("Truncated") : TEXT("Unreadable"), *ModelTiers[ActiveModelTier + 1].Model);
+		SendTurn(PlayerInput, ActiveModelTier + 1);
+		return;
+	}
+
+	// Nothing left to escalate to: end the turn like a request that got no answer, rather than apply an empty verdict
+	if (!bDecoded)
+	{
+		HandleRequestFailed(PlayerInput);
+		return;
+	}
 
 	UE_LOG(LogTemp, Warning, TEXT("[RulesAgent::HandleResponse] Player action bSuccess=%s"), RulesWorldStateUpdate.bSuccess ? TEXT("true") : TEXT("false"));
 
@@ -73,49 +107,16 @@ void URulesAgent::HandleResponse(const FString& ResponseContent, const FString&
 	}
 }
 
-void URulesAgent::JsonToRulesUpdate(const FString& InJson, FRulesUpdate& OutRulesUpdate, FString& OutRulesResultJson)
+bool URulesAgent::JsonToRulesUpdate(const FString& InJson, FRulesUpdate& OutRulesUpdate, FString& OutRulesResultJson, bool* bOutTruncated /*=nullptr*/)
 {
-	FString CleanJson = InJson;
-
-	// Remove whitespace/newlines
-	CleanJson.TrimStartAndEndInline();
-
-	// Remove UTF-8 BOM if present
-	if (CleanJson.Len() > 0 && CleanJson[0] == 0xFEFF)
-	{
-		CleanJson.RemoveAt(0);
-	}
-
-	// Strip markdown code fences
-	CleanJson = CleanJson.Replace(TEXT("```json"), TEXT(""));
-	CleanJson = CleanJson.Replace(TEXT("```JSON"), TEXT(""));
-	CleanJson = CleanJson.Replace(TEXT("```"), TEXT(""));
-	OutRulesResultJson = CleanJson;
-	
-	UE_LOG(LogTemp, Log, TEXT("[RulesAgent::JsonToRulesUpdate] Cleaned JSON: %s"), *CleanJson);
-	
-	TSharedPtr<FJsonObject> RootObj;
-	TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(CleanJson);
-	if (!FJsonSerializer::Deserialize(Reader, RootObj) || !RootObj.IsValid())
-	{
-		UE_LOG(LogTemp, Error, TEXT("[RulesAgent::JsonToRulesUpdate] Failed to parse CleanJson into root object: %s"), *CleanJson);
-		return;
-	}
-	
-	// Now convert the parsed object into FRulesUpdate
-	if (!FJsonObjectConverter::JsonObjectToUStruct(
-		RootObj.ToSharedRef(),
-		FRulesUpdate::StaticStruct(),
-		&OutRulesUpdate,
-		0, 0))
+	// One pass over the reply: skips fences, BOM and prose, and repairs trailing commas or a truncated object on the way
+	if (!FRulesUpdateDecoder::Decode(InJson, OutRulesUpdate, OutRulesResultJson, bOutTruncated))
 	{
-		UE_LOG(LogTemp, Error, TEXT("[RulesAgent::JsonToRulesUpdate] Failed to convert JSON to FRulesUpdate struct."));
+		UE_LOG(LogTemp, Error, TEXT("[RulesAgent::JsonToRulesUpdate] No rules result found in response: %s"), *InJson);
+		OutRulesResultJson = InJson.TrimStartAndEnd();
+		return false;
 	}
 
-	if (!OutRulesUpdate.bSuccess)
-	{
-		__nop();
-		OutRulesUpdate.bSuccess = RootObj->GetBoolField(TEXT("success"));
-		__nop();
-	}
-}
+	UE_LOG(LogTemp, Log, TEXT("[RulesAgent::JsonToRulesUpdate] Cleaned JSON: %s"), *OutRulesResultJson);
+	return true;
+}
\ No newline at end of file
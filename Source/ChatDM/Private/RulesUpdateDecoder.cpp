@@ -0,0 +1,540 @@
+#include "RulesUpdateDecoder.h"
+
+namespace
+{
+	/**
+	 * Lenient forward-only cursor over the reply text. Running out of input between an object's members is treated as a
+	 * truncated reply, anywhere else (in a key, a value or an array) as an error: what arrived of it can't be trusted.
+	 */
+	struct FLenientCursor
+	{
+		const TCHAR* Pos;
+		const TCHAR* End;
+
+		/** Set once the input ran out before the object was closed. */
+		bool bTruncated = false;
+
+		/** Set when the input ran out in the middle of a key, a value or an array. The reply is rejected. */
+		bool bCutOff = false;
+
+		/** Closing braces for the objects still open when the input ran out, innermost last. */
+		TArray<TCHAR, TInlineAllocator<16>> OpenContainers;
+
+		/** Whether any member we recognize was decoded, so prose like "{see below}" isn't mistaken for the result. */
+		bool bFoundKnownKey = false;
+
+		void SkipWhitespace()
+		{
+			while (Pos < End && FChar::IsWhitespace(*Pos))
+			{
+				++Pos;
+			}
+		}
+
+		bool AtEnd()
+		{
+			SkipWhitespace();
+			if (Pos >= End)
+			{
+				bTruncated = true;
+				return true;
+			}
+			return false;
+		}
+
+		/** Note that the input ran out partway through something. Always returns false, for the caller to return. */
+		bool CutOff()
+		{
+			bTruncated = true;
+			bCutOff = true;
+			return false;
+		}
+
+		bool Consume(const TCHAR Char)
+		{
+			SkipWhitespace();
+			if (Pos < End && *Pos == Char)
+			{
+				++Pos;
+				return true;
+			}
+			return false;
+		}
+
+		/** Consume a literal. The input ending in the middle of one cuts the reply off. */
+		bool ConsumeLiteral(const FStringView Literal)
+		{
+			SkipWhitespace();
+			const FStringView Remaining(Pos, static_cast<int32>(End - Pos));
+			if (Remaining.StartsWith(Literal, ESearchCase::CaseSensitive))
+			{
+				Pos += Literal.Len();
+				return true;
+			}
+			if (!Remaining.IsEmpty() && Literal.StartsWith(Remaining, ESearchCase::CaseSensitive))
+			{
+				return CutOff();
+			}
+			return false;
+		}
+
+		/** Read an object key. Keys never need unescaping here, so this is a view into the input. */
+		bool ReadKey(FStringView& OutKey)
+		{
+			if (!Consume(TEXT('"')))
+			{
+				return false;
+			}
+
+			const TCHAR* Start = Pos;
+			while (Pos < End && *Pos != TEXT('"'))
+			{
+				Pos += *Pos == TEXT('\\') ? 2 : 1;
+			}
+			if (Pos >= End)
+			{
+				return CutOff();
+			}
+
+			OutKey = FStringView(Start, static_cast<int32>(Pos - Start));
+			++Pos;
+			return true;
+		}
+
+		/** Read a string value. A string the input ends in cuts the reply off, half an item name is no item name. */
+		bool ReadString(FString& OutString)
+		{
+			if (!Consume(TEXT('"')))
+			{
+				return false;
+			}
+
+			OutString.Reset();
+			while (Pos < End && *Pos != TEXT('"'))
+			{
+				if (*Pos != TEXT('\\'))
+				{
+					OutString.AppendChar(*Pos++);
+					continue;
+				}
+
+				if (++Pos >= End)
+				{
+					return CutOff();
+				}
+
+				const TCHAR Escaped = *Pos++;
+				switch (Escaped)
+				{
+				case TEXT('n'): OutString.AppendChar(TEXT('\n')); break;
+				case TEXT('r'): OutString.AppendChar(TEXT('\r')); break;
+				case TEXT('t'): OutString.AppendChar(TEXT('\t')); break;
+				case TEXT('b'): OutString.AppendChar(TEXT('\b')); break;
+				case TEXT('f'): OutString.AppendChar(TEXT('\f')); break;
+				case TEXT('u'):
+					{
+						// TCHAR is UTF-16 on our platforms, so surrogate pairs pass straight through as two units
+						uint32 CodeUnit = 0;
+						int32 Digits = 0;
+						for (; Digits < 4 && Pos < End && FChar::IsHexDigit(*Pos); ++Digits, ++Pos)
+						{
+							CodeUnit = (CodeUnit << 4) | FParse::HexDigit(*Pos);
+						}
+						if (Digits == 4)
+						{
+							OutString.AppendChar(static_cast<TCHAR>(CodeUnit));
+						}
+					}
+					break;
+				default:
+					// \" \\ \/
+					OutString.AppendChar(Escaped);
+					break;
+				}
+			}
+
+			if (Pos >= End)
+			{
+				return CutOff();
+			}
+
+			++Pos;
+			return true;
+		}
+
+		/** Read an integer, also accepting fractions, quoted numbers and null (which leaves OutValue alone). */
+		bool ReadInt(int32& OutValue)
+		{
+			if (ConsumeLiteral(TEXT("null")))
+			{
+				return true;
+			}
+			if (bCutOff || AtEnd())
+			{
+				return CutOff();
+			}
+
+			const bool bQuoted = Consume(TEXT('"'));
+			const TCHAR* Start = Pos;
+			while (Pos < End && (FChar::IsDigit(*Pos) || *Pos == TEXT('-') || *Pos == TEXT('+') || *Pos == TEXT('.') || *Pos == TEXT('e') || *Pos == TEXT('E')))
+			{
+				++Pos;
+			}
+
+			// Without anything after it, "1" may well have been on its way to "12"
+			if (Pos >= End)
+			{
+				return CutOff();
+			}
+			if (Pos == Start)
+			{
+				return false;
+			}
+
+			OutValue = FMath::RoundToInt(FCString::Atod(*FString(static_cast<int32>(Pos - Start), Start)));
+			if (bQuoted && !Consume(TEXT('"')))
+			{
+				return AtEnd() ? CutOff() : false;
+			}
+			return true;
+		}
+
+		/** Read a boolean, also accepting "true"/"false" strings and numbers. */
+		bool ReadBool(bool& OutValue)
+		{
+			if (ConsumeLiteral(TEXT("true")))
+			{
+				OutValue = true;
+				return true;
+			}
+			if (ConsumeLiteral(TEXT("false")) || ConsumeLiteral(TEXT("null")))
+			{
+				OutValue = false;
+				return true;
+			}
+			if (bCutOff || AtEnd())
+			{
+				return CutOff();
+			}
+
+			if (*Pos == TEXT('"'))
+			{
+				FString Text;
+				if (!ReadString(Text))
+				{
+					return false;
+				}
+				OutValue = FCString::ToBool(*Text);
+				return true;
+			}
+
+			int32 Number = 0;
+			if (ReadInt(Number))
+			{
+				OutValue = Number != 0;
+				return true;
+			}
+			return false;
+		}
+
+		/** Skip over any value, including unquoted junk up to the next delimiter. */
+		bool SkipValue()
+		{
+			if (AtEnd())
+			{
+				return CutOff();
+			}
+
+			if (*Pos == TEXT('"'))
+			{
+				FString Ignored;
+				return ReadString(Ignored);
+			}
+			if (*Pos == TEXT('{'))
+			{
+				return ForEachMember([this](FStringView) { return SkipValue(); });
+			}
+			if (*Pos == TEXT('['))
+			{
+				return ForEachElement([this](int32) { return SkipValue(); });
+			}
+
+			const TCHAR* Start = Pos;
+			while (Pos < End && *Pos != TEXT(',') && *Pos != TEXT('}') && *Pos != TEXT(']') && !FChar::IsWhitespace(*Pos))
+			{
+				++Pos;
+			}
+			if (Pos >= End)
+			{
+				return CutOff();
+			}
+			return Pos > Start;
+		}
+
+		/**
+		 * Walk an object's members, OnMember(Key) must consume the member's value.
+		 * Stray, trailing and missing commas are all accepted, and so is the input ending between members before the closing brace.
+		 */
+		template <typename FunctorType>
+		bool ForEachMember(FunctorType&& OnMember)
+		{
+			if (!Consume(TEXT('{')))
+			{
+				return false;
+			}
+			OpenContainers.Push(TEXT('}'));
+
+			while (!AtEnd())
+			{
+				if (Consume(TEXT('}')))
+				{
+					OpenContainers.Pop();
+					return true;
+				}
+				if (Consume(TEXT(',')))
+				{
+					continue;
+				}
+
+				FStringView Key;
+				if (!ReadKey(Key))
+				{
+					return false;
+				}
+				if (!Consume(TEXT(':')))
+				{
+					return AtEnd() ? CutOff() : false;
+				}
+				if (!OnMember(Key) || bCutOff)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/**
+		 * Walk an array's elements with the same comma leniency as ForEachMember, OnElement(Index) must consume the element.
+		 * An array the input ends in cuts the reply off: the elements that did arrive would read as the whole list.
+		 */
+		template <typename FunctorType>
+		bool ForEachElement(FunctorType&& OnElement)
+		{
+			if (!Consume(TEXT('[')))
+			{
+				return false;
+			}
+
+			int32 Index = 0;
+			while (!AtEnd())
+			{
+				if (Consume(TEXT(']')))
+				{
+					return true;
+				}
+				if (Consume(TEXT(',')))
+				{
+					continue;
+				}
+
+				if (!OnElement(Index++) || bCutOff)
+				{
+					return false;
+				}
+			}
+			return CutOff();
+		}
+
+		/** Read an array of strings, skipping any elements that aren't strings. */
+		bool ReadStringArray(TArray<FString>& OutStrings)
+		{
+			if (ConsumeLiteral(TEXT("null")))
+			{
+				return true;
+			}
+
+			OutStrings.Reset();
+			return ForEachElement([this, &OutStrings](int32)
+			{
+				SkipWhitespace();
+				if (Pos < End && *Pos == TEXT('"'))
+				{
+					return ReadString(OutStrings.Emplace_GetRef());
+				}
+				return SkipValue();
+			});
+		}
+
+		/** Match a key against its JsonProperty name (and optionally the C++ name), ignoring case like FJsonObjectConverter does. */
+		bool KeyIs(const FStringView Key, const TCHAR* JsonName, const TCHAR* AltName = nullptr)
+		{
+			if (Key.Equals(JsonName, ESearchCase::IgnoreCase) || (AltName && Key.Equals(AltName, ESearchCase::IgnoreCase)))
+			{
+				bFoundKnownKey = true;
+				return true;
+			}
+			return false;
+		}
+	};
+
+	bool DecodeEnemyUpdate(FLenientCursor& Cursor, FEnemyUpdate& OutEnemy)
+	{
+		return Cursor.ForEachMember([&](const FStringView Key)
+		{
+			if (Cursor.KeyIs(Key, TEXT("enemyIndex")))
+			{
+				return Cursor.ReadInt(OutEnemy.EnemyIndex);
+			}
+			if (Cursor.KeyIs(Key, TEXT("name")))
+			{
+				return Cursor.ReadString(OutEnemy.Name) || Cursor.SkipValue();
+			}
+			if (Cursor.KeyIs(Key, TEXT("health")))
+			{
+				return Cursor.ReadInt(OutEnemy.Health);
+			}
+			if (Cursor.KeyIs(Key, TEXT("status")))
+			{
+				return Cursor.ReadString(OutEnemy.Status) || Cursor.SkipValue();
+			}
+			return Cursor.SkipValue();
+		});
+	}
+
+	bool DecodeRoomUpdate(FLenientCursor& Cursor, FRoomUpdate& OutRoom)
+	{
+		return Cursor.ForEachMember([&](const FStringView Key)
+		{
+			if (Cursor.KeyIs(Key, TEXT("roomIndex")))
+			{
+				return Cursor.ReadInt(OutRoom.RoomIndex);
+			}
+			if (Cursor.KeyIs(Key, TEXT("items")))
+			{
+				return Cursor.ReadStringArray(OutRoom.Items);
+			}
+			if (Cursor.KeyIs(Key, TEXT("enemies")))
+			{
+				OutRoom.Enemies.Reset();
+				return Cursor.ForEachElement([&](int32)
+				{
+					return DecodeEnemyUpdate(Cursor, OutRoom.Enemies.Emplace_GetRef());
+				});
+			}
+			return Cursor.SkipValue();
+		});
+	}
+
+	bool DecodeWorldStateUpdate(FLenientCursor& Cursor, FWorldStateUpdate& OutUpdate)
+	{
+		return Cursor.ForEachMember([&](const FStringView Key)
+		{
+			if (Cursor.KeyIs(Key, TEXT("currentRoomIndex")))
+			{
+				// null says as little as leaving the member out
+				if (Cursor.ConsumeLiteral(TEXT("null")))
+				{
+					return true;
+				}
+				OutUpdate.bHasCurrentRoomIndex = Cursor.ReadInt(OutUpdate.CurrentRoomIndex);
+				return OutUpdate.bHasCurrentRoomIndex;
+			}
+			if (Cursor.KeyIs(Key, TEXT("playerHeldItems")))
+			{
+				return Cursor.ReadStringArray(OutUpdate.PlayerHeldItems);
+			}
+			if (Cursor.KeyIs(Key, TEXT("rooms")))
+			{
+				OutUpdate.Rooms.Reset();
+				return Cursor.ForEachElement([&](int32)
+				{
+					return DecodeRoomUpdate(Cursor, OutUpdate.Rooms.Emplace_GetRef());
+				});
+			}
+			return Cursor.SkipValue();
+		});
+	}
+
+	bool DecodeRulesUpdate(FLenientCursor& Cursor, FRulesUpdate& OutUpdate)
+	{
+		return Cursor.ForEachMember([&](const FStringView Key)
+		{
+			if (Cursor.KeyIs(Key, TEXT("success"), TEXT("bSuccess")))
+			{
+				return Cursor.ReadBool(OutUpdate.bSuccess);
+			}
+			if (Cursor.KeyIs(Key, TEXT("reason")))
+			{
+				return Cursor.ReadString(OutUpdate.Reason) || Cursor.SkipValue();
+			}
+			if (Cursor.KeyIs(Key, TEXT("itemsPickedUp")))
+			{
+				return Cursor.ReadStringArray(OutUpdate.ItemsPickedUp);
+			}
+			if (Cursor.KeyIs(Key, TEXT("stateChanges")))
+			{
+				return Cursor.ConsumeLiteral(TEXT("null")) || DecodeWorldStateUpdate(Cursor, OutUpdate.StateChanges);
+			}
+			return Cursor.SkipValue();
+		});
+	}
+}
+
+bool FRulesUpdateDecoder::Decode(const FStringView Text, FRulesUpdate& OutRulesUpdate, FString& OutJson, bool* bOutTruncated /*=nullptr*/)
+{
+	if (bOutTruncated)
+	{
+		*bOutTruncated = false;
+	}
+
+	const TCHAR* const TextEnd = Text.GetData() + Text.Len();
+
+	// Fences, a BOM and any prose all sit outside the object, so just try each '{' until one decodes as a rules result.
+	// A well-formed reply succeeds on the first.
+	for (const TCHAR* Start = Text.GetData(); Start < TextEnd; ++Start)
+	{
+		if (*Start != TEXT('{'))
+		{
+			continue;
+		}
+
+		FLenientCursor Cursor{ Start, TextEnd };
+		FRulesUpdate Update = FRulesUpdate();
+		const bool bDecoded = DecodeRulesUpdate(Cursor, Update);
+
+		// Every '{' after this one is inside the value that was cut off, there's nothing complete left to find
+		if (Cursor.bCutOff)
+		{
+			break;
+		}
+		if (!bDecoded || !Cursor.bFoundKnownKey)
+		{
+			continue;
+		}
+
+		OutRulesUpdate = MoveTemp(Update);
+		OutJson = FString(static_cast<int32>(Cursor.Pos - Start), Start);
+
+		// The reply stopped between members, close the objects it left open so downstream consumers get well-formed JSON
+		if (Cursor.bTruncated)
+		{
+			OutJson.TrimEndInline();
+			if (OutJson.EndsWith(TEXT(",")))
+			{
+				OutJson.LeftChopInline(1);
+			}
+			for (int32 Index = Cursor.OpenContainers.Num() - 1; Index >= 0; --Index)
+			{
+				OutJson.AppendChar(Cursor.OpenContainers[Index]);
+			}
+		}
+		if (bOutTruncated)
+		{
+			*bOutTruncated = Cursor.bTruncated;
+		}
+		return true;
+	}
+
+	OutRulesUpdate = FRulesUpdate();
+	return false;
+}
\ No newline at end of file
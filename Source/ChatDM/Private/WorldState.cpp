@@ -0,0 +1,28 @@
+#include "WorldState.h"
+
+int32 FWorldState::FindRoomSlot(const int32 RoomIndex) const
+{
+	const int32* Slot = RoomSlots.Find(RoomIndex);
+	if (Slot && Rooms.IsValidIndex(*Slot) && Rooms[*Slot].RoomIndex == RoomIndex)
+	{
+		return *Slot;
+	}
+
+	// A miss can be trusted when every room is indexed, anything else means Rooms changed behind the index's back
+	if (!Slot && RoomSlots.Num() == Rooms.Num())
+	{
+		return INDEX_NONE;
+	}
+	return Rooms.IndexOfByPredicate([RoomIndex](const FRoom& Room) { return Room.RoomIndex == RoomIndex; });
+}
+
+void FWorldState::BuildIndexes()
+{
+	RoomSlots.Reset();
+	RoomSlots.Reserve(Rooms.Num());
+	for (int32 Slot = 0; Slot < Rooms.Num(); ++Slot)
+	{
+		RoomSlots.FindOrAdd(Rooms[Slot].RoomIndex, Slot);
+		Rooms[Slot].BuildIndexes();
+	}
+}
\ No newline at end of file
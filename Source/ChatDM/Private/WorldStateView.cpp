@@ -0,0 +1,231 @@
+#include "WorldStateView.h"
+
+#include "JsonObjectConverter.h"
+#include "Policies/CondensedJsonPrintPolicy.h"
+#include "Serialization/JsonSerializer.h"
+
+FWorldState FWorldStateView::BuildNeighborhood(const FWorldState& State, const int32 Depth)
+{
+	FWorldState View;
+	View.CurrentRoomIndex = State.CurrentRoomIndex;
+	View.PlayerHeldItems = State.PlayerHeldItems;
+
+	const int32 CurrentSlot = State.FindRoomSlot(State.CurrentRoomIndex);
+	if (CurrentSlot == INDEX_NONE)
+	{
+		return View;
+	}
+
+	// Breadth-first walk over the exits, one ring of rooms per step of depth. Rooms are tracked by their slot in State.Rooms.
+	TBitArray<> Visited(false, State.Rooms.Num());
+	TArray<int32> Frontier = { CurrentSlot };
+	Visited[CurrentSlot] = true;
+
+	for (int32 Step = 0; Step < Depth && !Frontier.IsEmpty(); ++Step)
+	{
+		TArray<int32> NextFrontier;
+		for (const int32 Slot : Frontier)
+		{
+			for (const int32 ExitRoomIndex : State.Rooms[Slot].ExitRoomIndices)
+			{
+				const int32 ExitSlot = ExitRoomIndex != INDEX_NONE ? State.FindRoomSlot(ExitRoomIndex) : INDEX_NONE;
+				if (ExitSlot != INDEX_NONE && !Visited[ExitSlot])
+				{
+					Visited[ExitSlot] = true;
+					NextFrontier.Add(ExitSlot);
+				}
+			}
+		}
+		Frontier = MoveTemp(NextFrontier);
+	}
+
+	// Keep the dungeon's room order so the output is stable from turn to turn
+	for (TConstSetBitIterator<> It(Visited); It; ++It)
+	{
+		View.Rooms.Add(State.Rooms[It.GetIndex()]);
+	}
+
+	return View;
+}
+
+namespace
+{
+	/** Reflection-driven JSON object for State, minus the fields of the parts that weren't asked for. */
+	TSharedPtr<FJsonObject> ToJsonObject(const FWorldState& State, const EWorldStateParts Parts)
+	{
+		const TSharedPtr<FJsonObject> JsonObject = FJsonObjectConverter::UStructToJsonObject(State);
+		if (!JsonObject.IsValid() || Parts == EWorldStateParts::All)
+		{
+			return JsonObject;
+		}
+
+		const bool bStatic = EnumHasAnyFlags(Parts, EWorldStateParts::Static);
+		const bool bVolatile = EnumHasAnyFlags(Parts, EWorldStateParts::Volatile);
+		if (!bVolatile)
+		{
+			JsonObject->RemoveField(TEXT("currentRoomIndex"));
+			JsonObject->RemoveField(TEXT("playerHeldItems"));
+		}
+
+		const TArray<TSharedPtr<FJsonValue>>* Rooms = nullptr;
+		if (JsonObject->TryGetArrayField(TEXT("rooms"), Rooms))
+		{
+			for (const TSharedPtr<FJsonValue>& RoomValue : *Rooms)
+			{
+				const TSharedPtr<FJsonObject>* Room = nullptr;
+				if (!RoomValue->TryGetObject(Room))
+				{
+					continue;
+				}
+
+				if (!bStatic)
+				{
+					(*Room)->RemoveField(TEXT("name"));
+					(*Room)->RemoveField(TEXT("description"));
+					(*Room)->RemoveField(TEXT("exits"));
+					(*Room)->RemoveField(TEXT("exitRoomIndices"));
+				}
+				if (!bVolatile)
+				{
+					(*Room)->RemoveField(TEXT("items"));
+					(*Room)->RemoveField(TEXT("enemies"));
+				}
+			}
+		}
+		return JsonObject;
+	}
+}
+
+FString FWorldStateView::ToJson(const FWorldState& State, const FWorldStateViewSettings& Settings, const EWorldStateParts Parts /*=EWorldStateParts::All*/)
+{
+	// Only pay for the copy when we're actually trimming the world down
+	TOptional<FWorldState> Neighborhood;
+	if (Settings.Scope == EWorldStateScope::Neighborhood)
+	{
+		Neighborhood = BuildNeighborhood(State, Settings.Depth);
+	}
+	const FWorldState& ViewState = Neighborhood.IsSet() ? Neighborhood.GetValue() : State;
+
+	FString OutputString;
+	switch (Settings.Format)
+	{
+	case EWorldStateFormat::Compact:
+		OutputString = ToCompactJson(ViewState, Parts);
+		break;
+	case EWorldStateFormat::MinifiedJson:
+		if (const TSharedPtr<FJsonObject> JsonObject = ToJsonObject(ViewState, Parts))
+		{
+			const TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> Writer = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&OutputString);
+			FJsonSerializer::Serialize(JsonObject.ToSharedRef(), Writer);
+		}
+		break;
+	default:
+		if (Parts == EWorldStateParts::All)
+		{
+			FJsonObjectConverter::UStructToJsonObjectString(ViewState, OutputString);
+		}
+		else if (const TSharedPtr<FJsonObject> JsonObject = ToJsonObject(ViewState, Parts))
+		{
+			FJsonSerializer::Serialize(JsonObject.ToSharedRef(), TJsonWriterFactory<>::Create(&OutputString));
+		}
+		break;
+	}
+	return OutputString;
+}
+
+namespace
+{
+	using FCondensedJsonWriter = TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>;
+
+	void WriteStringArray(FCondensedJsonWriter& Writer, const TCHAR* Identifier, const TArray<FString>& Values)
+	{
+		Writer.WriteArrayStart(Identifier);
+		for (const FString& Value : Values)
+		{
+			Writer.WriteValue(Value);
+		}
+		Writer.WriteArrayEnd();
+	}
+}
+
+FString FWorldStateView::ToCompactJson(const FWorldState& State, const EWorldStateParts Parts /*=EWorldStateParts::All*/)
+{
+	const bool bStatic = EnumHasAnyFlags(Parts, EWorldStateParts::Static);
+	const bool bVolatile = EnumHasAnyFlags(Parts, EWorldStateParts::Volatile);
+
+	FString OutputString;
+	const TSharedRef<FCondensedJsonWriter> Writer = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&OutputString);
+
+	Writer->WriteObjectStart();
+	if (bVolatile)
+	{
+		Writer->WriteValue(TEXT("cur"), State.CurrentRoomIndex);
+		WriteStringArray(*Writer, TEXT("inv"), State.PlayerHeldItems);
+	}
+
+	Writer->WriteArrayStart(TEXT("rooms"));
+	for (const FRoom& Room : State.Rooms)
+	{
+		Writer->WriteObjectStart();
+		Writer->WriteValue(TEXT("i"), Room.RoomIndex);
+		if (bStatic)
+		{
+			Writer->WriteValue(TEXT("n"), Room.Name);
+			Writer->WriteValue(TEXT("d"), Room.Description);
+		}
+		if (bVolatile)
+		{
+			WriteStringArray(*Writer, TEXT("it"), Room.Items);
+		}
+
+		// Exits as direction -> destination room
+		if (bStatic)
+		{
+			Writer->WriteObjectStart(TEXT("ex"));
+			for (int32 ExitIndex = 0; ExitIndex < Room.Exits.Num(); ++ExitIndex)
+			{
+				Writer->WriteValue(Room.Exits[ExitIndex].ToString(), Room.ExitRoomIndices.IsValidIndex(ExitIndex) ? Room.ExitRoomIndices[ExitIndex] : INDEX_NONE);
+			}
+			Writer->WriteObjectEnd();
+		}
+
+		// Enemies as rows, the column order is given once in the legend
+		if (bVolatile)
+		{
+			Writer->WriteArrayStart(TEXT("en"));
+			for (const FEnemy& Enemy : Room.Enemies)
+			{
+				Writer->WriteArrayStart();
+				Writer->WriteValue(Enemy.EnemyIndex);
+				Writer->WriteValue(Enemy.Name.ToString());
+				Writer->WriteValue(Enemy.Health);
+				Writer->WriteValue(Enemy.Status);
+				Writer->WriteValue(Enemy.IntentOrGoal);
+				Writer->WriteArrayEnd();
+			}
+			Writer->WriteArrayEnd();
+		}
+
+		Writer->WriteObjectEnd();
+	}
+	Writer->WriteArrayEnd();
+
+	Writer->WriteObjectEnd();
+	Writer->Close();
+
+	return OutputString;
+}
+
+const FString& FWorldStateView::GetFormatLegend(const EWorldStateFormat Format)
+{
+	static const FString NoLegend;
+	static const FString CompactLegend = TEXT(
+		"WORLDSTATE and DUNGEON blocks use a compact encoding: "
+		"cur = currentRoomIndex, inv = playerHeldItems, rooms = list of rooms where "
+		"i = roomIndex, n = name, d = description, it = items, "
+		"ex = exits as {direction: destination roomIndex, -1 if unknown}, "
+		"en = enemies, one row per enemy: [enemyIndex, name, health, status, intentOrGoal]. "
+		"This only affects how the world is given to you; any JSON you return keeps its usual field names.");
+
+	return Format == EWorldStateFormat::Compact ? CompactLegend : NoLegend;
+}
\ No newline at end of file
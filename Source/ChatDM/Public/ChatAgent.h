@@ -4,8 +4,129 @@
 
 #include "CoreMinimal.h"
 #include "ChatMessage.h"
+#include "ChatMetrics.h"
+#include "ChatModelRouter.h"
+#include "ChatRateLimiter.h"
+#include "Interfaces/IHttpRequest.h"
+#include "WorldStateView.h"
 #include "ChatAgent.generated.h"
 
+/** How much conversation history an agent sends along with each request. The system message is always kept. */
+UENUM(BlueprintType)
+enum class EChatContextPolicy : uint8
+{
+	/** Send the whole message log every time. */
+	FullHistory,
+	/** Send only the system message and the newest turn. */
+	Stateless,
+	/** Keep the newest MaxContextTurns turns. */
+	SlidingWindow,
+	/** Drop the oldest turns until the estimated prompt fits in MaxContextTokens. */
+	TokenBudget
+};
+
+/** How the parts of a request are ordered. Matters for the provider's prompt cache, which only reuses a byte-identical prefix. */
+UENUM(BlueprintType)
+enum class EChatPromptLayout : uint8
+{
+	/** Every user message starts with the full world state, followed by the player's input (the original layout). */
+	WorldStateFirst,
+	/**
+	 * The dungeon's fixed rooms go in a pinned message after the system prompt, user messages lead with the player's input
+	 * and end with only the parts of the world state that can change, and history is trimmed in bulk rather than turn by turn.
+	 */
+	StablePrefix
+};
+
+/** How an agent deals with slow and failed requests. */
+USTRUCT(BlueprintType)
+struct FChatRetryPolicy
+{
+	GENERATED_BODY()
+
+	/** Give up on a single attempt after this many seconds. 0 means no limit. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Retry", meta = (ClampMin = "0"))
+	float AttemptTimeoutSeconds = 60.0f;
+
+	/** Stop retrying once this many seconds have passed since the request was made. 0 means no limit. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Retry", meta = (ClampMin = "0"))
+	float DeadlineSeconds = 120.0f;
+
+	/** Retries after a timeout, a dropped connection, a 429 or a 5xx. Other errors are not retried. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Retry", meta = (ClampMin = "0"))
+	int32 MaxRetries = 2;
+
+	/** Backoff before the first retry, doubled for every retry after it and jittered. A longer Retry-After from the server wins. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Retry", meta = (ClampMin = "0"))
+	float InitialBackoffSeconds = 1.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Retry", meta = (ClampMin = "0"))
+	float MaxBackoffSeconds = 8.0f;
+
+	/** Send a duplicate request when the first is slower than this agent's p95 latency, and take whichever answers first. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Retry")
+	bool bHedgeRequests = false;
+
+	/** Hedge delay used until enough latencies have been seen to estimate the p95. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Retry", meta = (ClampMin = "0"))
+	float DefaultHedgeDelaySeconds = 4.0f;
+};
+
+/** Per-request settings for UChatAgent::SendMessage. */
+struct FChatRequestOptions
+{
+	/** Ask the API for a server-sent event stream instead of a single response body. */
+	bool bStream = false;
+
+	/** Model to use for this request. Empty means one of the agent's ModelTiers. */
+	FString Model;
+
+	/** Which of the agent's ModelTiers to use. INDEX_NONE lets FChatModelRouter pick. */
+	int32 ModelTier = INDEX_NONE;
+
+	/** How long the reply may take, for picking the tier: until its first text when streamed, until it's complete otherwise. 0 means no budget. */
+	float LatencyBudgetSeconds = 0.0f;
+
+	/** Whether to tell the model how this agent's WORLDSTATE blocks are encoded, and send the DUNGEON message. Off for requests that carry no world state. */
+	bool bIncludeWorldStateLegend = true;
+
+	/** Answer this request from FChatResponseCache when an identical one has been answered before. */
+	bool bUseCache = false;
+
+	/** Where the request waits in line when the shared rate limits are tight. */
+	EChatRequestPriority Priority = EChatRequestPriority::Interactive;
+
+	/** Called with every content delta while a streamed response is arriving. */
+	TFunction<void(const FString& Delta)> OnDeltaCallback;
+
+	/** Called instead of the response callback when the request fails or the response can't be read. */
+	TFunction<void()> OnErrorCallback;
+};
+
+struct FChatRequestState;
+
+/** Handle to an in-flight agent request so callers can abandon it. */
+class CHATDM_API FChatRequestHandle
+{
+public:
+	/** Stop every attempt of the request and make sure none of its callbacks fire afterwards. */
+	void Cancel();
+
+	bool IsCancelled() const;
+
+	/** Whether the request is still waiting on an answer. */
+	bool IsActive() const;
+
+private:
+	friend class UChatAgent;
+
+	/** The request's attempts, timers and callbacks, shared with the HTTP callbacks. */
+	TSharedPtr<FChatRequestState> State;
+};
+
+/** Broadcasts that a turn's request failed for good (retries included), so whoever is running the turn can end it */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnAgentRequestFailed, const FString&, PlayerInput);
+
 /**
  * Base class for the different AI agents
  */
@@ -15,21 +136,151 @@ class CHATDM_API UChatAgent : public UObject
 	GENERATED_BODY()
 
 public:
-	const FString Model = TEXT("gpt-4o-mini");
+	UChatAgent();
+
 	FChatMessage SystemMessage;
 
+	/** Models this agent can run on, fastest and cheapest first. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Model")
+	TArray<FChatModelTier> ModelTiers;
+
+	/** The tier requests run on unless the latency budget says otherwise. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Model", meta = (ClampMin = "0"))
+	int32 DefaultModelTier = 0;
+
+	/** How much of the world this agent sees in its WORLDSTATE block. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Context")
+	FWorldStateViewSettings WorldStateView;
+
+	/** How the message log is trimmed before each request is built. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Context")
+	EChatContextPolicy ContextPolicy = EChatContextPolicy::FullHistory;
+
+	/** Order of the request's messages and of the blocks inside them. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Context")
+	EChatPromptLayout PromptLayout = EChatPromptLayout::StablePrefix;
+
+	/**
+	 * Largest dungeon whose whole map goes in the DUNGEON message when WorldStateView is scoped to a Neighborhood. Past it the
+	 * agent gets no DUNGEON message, and its WORLDSTATE blocks carry the fixed parts of only the rooms it can see.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Context", meta = (ClampMin = "0"))
+	int32 MaxDungeonMessageRooms = 32;
+
+	/** Number of turns (a user message and its replies) kept by the SlidingWindow policy. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Context", meta = (ClampMin = "1"))
+	int32 MaxContextTurns = 8;
+
+	/** Estimated prompt token budget enforced by the TokenBudget policy. The newest turn is always sent. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Context", meta = (ClampMin = "1"))
+	int32 MaxContextTokens = 8000;
+
+	/** Constrain replies to the JSON schema of ResponseStruct, for agents that have one. Needs a model that supports structured outputs. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Output")
+	bool bUseStructuredOutputs = true;
+
+	/** Answer every request this agent repeats from FChatResponseCache instead of the network. Meant for scripted and test runs, a cached reply never varies. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Output")
+	bool bCacheResponses = false;
+
+	/** Timeouts, retries and hedging for this agent's requests. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Network")
+	FChatRetryPolicy RetryPolicy;
+
+	/** Timings and token counts of the last request this agent got a reply to. */
+	UPROPERTY(BlueprintReadOnly, Category="ChatDM | Metrics")
+	FChatRequestMetrics LastRequestMetrics;
+
+	/** Tokens used by every request this agent has had answered. */
+	UPROPERTY(BlueprintReadOnly, Category="ChatDM | Metrics")
+	FChatTokenUsage TokenUsage;
+
+	/** Fired when the request for a turn fails and there is no answer coming. */
+	UPROPERTY(BlueprintAssignable, Category="ChatDM | Agent")
+	FOnAgentRequestFailed OnRequestFailed;
+
 	UFUNCTION()
 	virtual void Initialize(const FString& InPrompt);
 
+	/** Cancel the request for the turn in progress and take its unanswered message back out of the history. */
+	virtual void CancelRequests();
+
+	/** Build the DUNGEON message from the rooms' fixed parts. Call again if rooms are added or rewritten. */
+	void SetDungeon(const FWorldState& State);
+
+	/** Whether this agent's requests carry the DUNGEON message, so its WORLDSTATE blocks only need what can change. */
+	bool HasDungeonMessage() const { return PromptLayout == EChatPromptLayout::StablePrefix && !DungeonMessage.Content.IsEmpty(); }
+
 	/** Generic send message function which will handle creating, sending, and passing back the result of the HTTP Request. */
-	void SendMessage(TArray<FChatMessage>& MessageLog, TFunction<void(const FString& ResponseContent)> OnResponseCallback);
+	TSharedRef<FChatRequestHandle> SendMessage(TArray<FChatMessage>& MessageLog, TFunction<void(const FString& ResponseContent)> OnResponseCallback, const FChatRequestOptions& Options = FChatRequestOptions());
 
 protected:
+	friend struct FChatRequestState;
+
 	/** Meant for children to override so they can handle the response as they see fit. */
 	virtual void HandleResponse(const FString& ResponseContent, const FString& PlayerInput) {};
 
+	/**
+	 * Trim the oldest turns from the message log according to ContextPolicy. Leading system messages are pinned.
+	 * InjectedTokens is what the request adds outside the log (legend, DUNGEON) and counts against MaxContextTokens.
+	 */
+	void ApplyContextPolicy(TArray<FChatMessage>& MessageLog, int32 InjectedTokens = 0) const;
+
+	/** How many prompt tokens a piece of text costs, counted by FChatTokenizer. */
+	static int32 EstimateTokens(const FString& Text);
+
+	/** How many prompt tokens a message costs, including the per-message framing. */
+	static int32 EstimateTokens(const FChatMessage& Message);
+
+	/** The struct this agent's replies decode into. Set by agents with a structured reply to get a response_format schema generated for it. */
+	const UScriptStruct* ResponseStruct = nullptr;
+
+	/** The request for the turn in progress. */
+	TSharedPtr<FChatRequestHandle> ActiveRequest;
+
+	/** Options for a turn request, with failures reported through OnRequestFailed. */
+	FChatRequestOptions MakeTurnOptions(const FString& PlayerInput);
+
+	/** A turn request failed for good: forget it and tell listeners. */
+	virtual void HandleRequestFailed(const FString& PlayerInput);
+
+	/** Undo what sending the abandoned turn did to this agent's state. */
+	virtual void AbandonTurn() {}
+
+	/** Pop the newest message if it is a user message that never got a reply. */
+	static void DropUnansweredMessage(TArray<FChatMessage>& MessageLog);
+
+	/** The rooms' names, descriptions and exits, sent after the system prompt with the StablePrefix layout. Empty until SetDungeon(). */
+	FChatMessage DungeonMessage;
+
+	/** Size of the last request body, used to size the next one up front. */
+	int32 LastPayloadSize = 0;
+
+	/** Recent response latencies (time to first delta when streaming), oldest overwritten first. */
+	TArray<float> LatencySamples;
+	int32 NextLatencySample = 0;
+
+	/** Keep a finished request's metrics, add its tokens to the totals and publish them. */
+	void RecordRequestMetrics(const FChatRequestMetrics& Metrics);
+
+	/** Remember how long a request took to answer, for the hedge delay. */
+	void RecordLatency(float Seconds);
+
+	/** How long to wait before hedging: the p95 of recent latencies, or the policy's default until there are enough samples. */
+	float GetHedgeDelay() const;
+
+	/** Look up a prompt row in the DT_Prompts data table. Returns false (and logs) when the table or row is missing. */
+	bool LoadPromptRow(const FName& RowName, FString& OutPrompt) const;
+
 	/** Helper function that takes World State JSON and the Player's Input and wraps it in a single message. */
 	FString BuildWrappedUserMessage(const FString& CurrentWorldStateJson, const FString& UpdatedWorldStateJson, const FString& PlayerInput) const;
 	FString BuildWrappedUserMessage(const FString& CurrentWorldStateJson, const FString& PlayerInput) const;
+
+	/** The history form of a wrapped user message: the same message minus the world state snapshot. */
+	FString BuildHistoryUserMessage(const FString& RulesResultJson, const FString& PlayerInput) const;
+	FString BuildHistoryUserMessage(const FString& PlayerInput) const;
+
+	/** Push a message onto the log, first collapsing older messages to their HistoryContent so only the newest carries a full world state. */
+	static void AppendMessage(TArray<FChatMessage>& MessageLog, const FChatMessage& NewMessage);
 	
 };
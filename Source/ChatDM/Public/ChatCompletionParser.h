@@ -0,0 +1,36 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+// Token counts from a response's "usage" object.
+struct FChatCompletionUsage
+{
+	bool bValid = false;
+	int32 PromptTokens = 0;
+	int32 CompletionTokens = 0;
+	int32 TotalTokens = 0;
+
+	/** prompt_tokens_details.cached_tokens: how much of the prompt the server had cached from an earlier request. */
+	int32 CachedTokens = 0;
+};
+
+// The handful of fields we actually read out of a chat completion (or a streamed chunk of one).
+struct FChatCompletionResult
+{
+	/** choices[0].message.content, or choices[0].delta.content for a chunk. */
+	FString Content;
+	bool bHasContent = false;
+
+	FChatCompletionUsage Usage;
+};
+
+// Pull-parser that reads just the fields above straight from the raw UTF-8 response bytes, without building a JSON DOM.
+// Everything else in the body is skipped over without being decoded.
+struct CHATDM_API FChatCompletionParser
+{
+	/** Parse a complete chat.completion body. Returns false if the body isn't a well-formed JSON object. */
+	static bool ParseCompletion(const uint8* Data, int32 Len, FChatCompletionResult& OutResult);
+
+	/** Parse the JSON payload of one streamed chat.completion.chunk event. */
+	static bool ParseChunk(const uint8* Data, int32 Len, FChatCompletionResult& OutResult);
+};
\ No newline at end of file
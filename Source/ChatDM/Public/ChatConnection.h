@@ -0,0 +1,75 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+
+// Running totals for FChatConnection, reported by the ChatDM.Connection.Stats console command.
+// Warm and cold are a guess (see IsWarm()), the HTTP module doesn't tell us whether a request actually reused a connection.
+struct FChatConnectionStats
+{
+	/** Requests sent within IdleTimeoutSeconds of the endpoint last answering, and their total time. */
+	int32 WarmRequests = 0;
+	double WarmSeconds = 0.0;
+
+	/** Requests sent after the endpoint had been quiet for longer, or before it ever answered, and their total time. */
+	int32 ColdRequests = 0;
+	double ColdSeconds = 0.0;
+
+	int32 Prewarms = 0;
+	int32 KeepAlivePings = 0;
+};
+
+// The chat completions endpoint and the connection to it, shared by every agent.
+// The HTTP module already pools connections per host, so this just makes sure the pooled connection exists before
+// the first real request and doesn't go idle long enough for the server to drop it between turns.
+// To test against a local stand-in server, run with -ChatDMEndpoint=https://localhost:8443/v1/chat/completions
+// (and n.VerifyPeer=0 if its certificate is self-signed). The ChatDM commandlet's -ConnectionCheck run uses
+// Scripts/ConnectionStandIn.py to check that warm requests really are faster than a cold one.
+class CHATDM_API FChatConnection
+{
+public:
+	static FChatConnection& Get();
+
+	const FString& GetEndpoint() const { return Endpoint; }
+
+	/** Point every agent at a different endpoint. Ignored when the command line already picked one. */
+	void SetEndpoint(const FString& InEndpoint);
+
+	/** Open a connection to the endpoint ahead of the first request with a cheap HEAD request. */
+	void Prewarm();
+
+	/** Ping the endpoint whenever it has been idle for IntervalSeconds, so the pooled connection stays open. 0 stops pinging. */
+	void SetKeepAliveInterval(float IntervalSeconds);
+
+	/** Whether a request sent now should find an open connection: the endpoint answered less than IdleTimeoutSeconds ago. A heuristic. */
+	bool IsWarm() const;
+
+	/** Record a finished request (or ping) to the endpoint for the idle tracking and the stats. */
+	void NoteRequestComplete(bool bWasWarm, double Seconds);
+
+	const FChatConnectionStats& GetStats() const { return Stats; }
+
+	void LogStats() const;
+
+private:
+	FChatConnection();
+
+	/** Send a HEAD request to the endpoint. Any response at all means the connection is up. */
+	void SendPing();
+
+	bool TickKeepAlive(float DeltaTime);
+
+	FString Endpoint;
+	bool bEndpointFromCommandLine = false;
+
+	/** Idle time after which we assume the server has closed the connection. Most close keep-alive connections after about a minute. */
+	double IdleTimeoutSeconds = 55.0;
+
+	float KeepAliveIntervalSeconds = 0.0f;
+	FTSTicker::FDelegateHandle KeepAliveTickerHandle;
+
+	/** When we last heard back from the endpoint, 0 if never. */
+	double LastContactTime = 0.0;
+
+	FChatConnectionStats Stats;
+};
\ No newline at end of file
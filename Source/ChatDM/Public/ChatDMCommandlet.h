@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ChatDMCommandlet.generated.h"
+
+class UChatGPTManager;
+
+/*
+ * Plays ChatDM as plain text, with no map, game mode, player controller or UI.
+ * Player input is read a line per turn from stdin (or from a script file) and the narration is written to stdout.
+ *
+ *   UnrealEditor-Cmd ChatDM.uproject -run=ChatDM -nullrhi [-Input=Script.txt] [-Pipeline=Combined] [-Speculate] [-TurnTimeout=Seconds]
+ *
+ * Blank lines and lines starting with # in the input are skipped. The session ends at the end of the input.
+ * A turn that hasn't finished after TurnTimeout seconds (by default the agents' request deadlines for a rules and a
+ * narration request plus some slack) is abandoned and the session carries on; the exit code is then non-zero.
+ *
+ * With -ConnectionCheck[=Requests] no game is played. Instead it checks FChatConnection's warm/cold guess against a
+ * local stand-in server: one cold request, then warm ones back to back, which should be faster for reusing the connection.
+ *
+ *   python3 Scripts/ConnectionStandIn.py
+ *   UnrealEditor-Cmd ChatDM.uproject -run=ChatDM -nullrhi -ConnectionCheck=5 -ChatDMEndpoint=https://localhost:8443/v1/chat/completions -ini:Engine:[/Script/Engine.NetworkSettings]:n.VerifyPeer=false
+ *
+ * The exit code is non-zero when a request fails, is guessed wrong, or the warm requests are no faster than the cold one.
+ */
+UCLASS()
+class CHATDM_API UChatDMCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UChatDMCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	UPROPERTY()
+	UChatGPTManager* ChatGptManager = nullptr;
+
+	/* Longest a turn may run before it's abandoned */
+	float TurnTimeoutSeconds = 0.0f;
+
+	/* Turns abandoned for running past TurnTimeoutSeconds */
+	int32 TimedOutTurns = 0;
+
+	/* Time a turn gets by default: one rules and one narration request, each up to its agent's deadline, plus slack */
+	float GetDefaultTurnTimeout() const;
+
+	/* Tick HTTP and the core ticker until the manager has finished its turn, or abandon it once it runs out of time.
+	   Returns false if the turn was abandoned. */
+	bool PumpUntilIdle();
+
+	/* Send Requests HEAD requests to the endpoint, one cold then the rest warm, and check the timings. Returns the exit code. */
+	int32 RunConnectionCheck(int32 Requests);
+
+	/* Write narration to stdout */
+	UFUNCTION()
+	void HandleResponse(const FString& Response, bool IsPlayer);
+};
\ No newline at end of file
@@ -7,6 +7,8 @@
 class UChatGPTManager;
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnChatGptManagerCreated);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnNarrationStreamUpdated, const FString&, NarrationSoFar, bool, bIsFirstChunk);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnNarrationCompleted, const FString&, Narration, bool, bWasStreamed);
 
 UCLASS()
 class CHATDM_API AChatDMPlayerController : public APlayerController
@@ -19,6 +21,15 @@ public:
 	/* Delegate fired when ChatGPTManager is created */
 	UPROPERTY(BlueprintAssignable, Category="ChatDM")
 	FOnChatGptManagerCreated OnChatGptManagerCreated;
+
+	/* Delegate fired for every streamed piece of narration, with all of it so far, so the chat box can fill in a single entry as it arrives */
+	UPROPERTY(BlueprintAssignable, Category="ChatDM")
+	FOnNarrationStreamUpdated OnNarrationStreamUpdated;
+
+	/* Delegate fired with the finished narration. When bWasStreamed the text has already been shown through OnNarrationStreamUpdated
+	   and should replace that entry rather than be added as a new one. */
+	UPROPERTY(BlueprintAssignable, Category="ChatDM")
+	FOnNarrationCompleted OnNarrationCompleted;
 	
 	/* Send a request through the ChatGptManager */
 	UFUNCTION(BlueprintCallable, Category = "ChatDM")
@@ -36,5 +47,18 @@ private:
 	/* ChatGptManager reference */
 	UPROPERTY(BlueprintReadOnly, Category="ChatDM", meta = (AllowPrivateAccess = "true"))
 	UChatGPTManager* ChatGptManager;
+
+	/* The narration streamed in so far for the reply in progress */
+	UPROPERTY(BlueprintReadOnly, Category="ChatDM", meta = (AllowPrivateAccess = "true"))
+	FString StreamingNarration;
+
+	/* Whether any of the reply in progress has been streamed */
+	bool bNarrationStreaming = false;
+
+	UFUNCTION()
+	void HandleResponseChunk(const FString& Chunk, bool bIsFirstChunk);
+
+	UFUNCTION()
+	void HandleResponse(const FString& Response, bool IsPlayer);
 	
 };
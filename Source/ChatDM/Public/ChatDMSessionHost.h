@@ -0,0 +1,97 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+#include "Subsystems/EngineSubsystem.h"
+#include "WorldState.h"
+#include "ChatDMSessionHost.generated.h"
+
+class UChatGPTManager;
+
+/* One hosted game */
+USTRUCT()
+struct FChatDMSession
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	UChatGPTManager* Manager = nullptr;
+
+	/* When the session was created or last sent input, for closing idle sessions */
+	double LastActiveTime = 0.0;
+};
+
+/*
+ * Runs many independent ChatDM games in one process, e.g. a server offering ChatDM as a service.
+ * Every session has its own UChatGPTManager (world state, agents and their histories), while the prompts, the
+ * connection to the endpoint and the response cache are shared process-wide. Hosted sessions get a prompt token
+ * budget on every agent, which also caps how much history each one keeps, so per-session memory stays bounded.
+ */
+UCLASS(Config=Game)
+class CHATDM_API UChatDMSessionHost : public UEngineSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/* Hard cap on concurrent sessions. CreateSession refuses new ones past it. */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category="ChatDM | Sessions", meta = (ClampMin = "1"))
+	int32 MaxSessions = 4096;
+
+	/* Close sessions that haven't sent input for this many seconds. 0 keeps them until DestroySession. */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category="ChatDM | Sessions", meta = (ClampMin = "0"))
+	float SessionIdleTimeoutSeconds = 1800.0f;
+
+	/* Prompt token budget for each agent of a hosted session, which bounds the history it keeps. 0 leaves the agents' own settings. */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category="ChatDM | Sessions", meta = (ClampMin = "0"))
+	int32 SessionMaxContextTokens = 8000;
+
+	/* Create a session running StartingWorldState, or the default world when it has no rooms. Returns null at MaxSessions.
+	   Bind to the returned manager's delegates, then call StartSession to get the opening narration. */
+	UFUNCTION(BlueprintCallable, Category="ChatDM | Sessions")
+	UChatGPTManager* CreateSession(const FWorldState& StartingWorldState, FGuid& OutSessionId);
+
+	/* Ask for the session's opening narration */
+	UFUNCTION(BlueprintCallable, Category="ChatDM | Sessions")
+	bool StartSession(const FGuid& SessionId);
+
+	/* Send player input to a session. Returns false when there is no such session. */
+	UFUNCTION(BlueprintCallable, Category="ChatDM | Sessions")
+	bool SubmitInput(const FGuid& SessionId, const FString& PlayerInput);
+
+	/* Cancel whatever the session has in flight and forget it */
+	UFUNCTION(BlueprintCallable, Category="ChatDM | Sessions")
+	void DestroySession(const FGuid& SessionId);
+
+	UFUNCTION(BlueprintCallable, Category="ChatDM | Sessions")
+	UChatGPTManager* FindSession(const FGuid& SessionId) const;
+
+	UFUNCTION(BlueprintCallable, Category="ChatDM | Sessions")
+	int32 GetNumSessions() const { return Sessions.Num(); }
+
+	void LogStats() const;
+
+private:
+	UPROPERTY()
+	TMap<FGuid, FChatDMSession> Sessions;
+
+	/* Whether we set up the shared connection, which happens when the first session is created */
+	bool bConnectionConfigured = false;
+
+	FTSTicker::FDelegateHandle ReapTickerHandle;
+
+	int32 SessionsCreated = 0;
+	int32 SessionsRefused = 0;
+	int32 SessionsTimedOut = 0;
+
+	/* Point the shared connection at the endpoint and keep it warm, using the manager's defaults */
+	void ConfigureConnection();
+
+	/* Put every agent of the session on the session token budget */
+	void ApplySessionBudget(UChatGPTManager& Manager) const;
+
+	/* Close sessions that have been idle longer than SessionIdleTimeoutSeconds */
+	bool TickReapIdleSessions(float DeltaTime);
+};
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include "CoreMinimal.h"
 #include "ChatMessage.h"
+#include "ChatMetrics.h"
+#include "CombinedAgent.h"
 #include "Interfaces/IHttpRequest.h"
 #include "NarratorAgent.h"
 #include "RulesAgent.h"
@@ -12,6 +14,28 @@
 struct FRulesUpdate;
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnChatGptResponseReceived, const FString&, Response, bool, IsPlayer);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnChatGptResponseChunkReceived, const FString&, Chunk, bool, bIsFirstChunk);
+
+/* How a player turn is turned into AI requests */
+UENUM(BlueprintType)
+enum class EChatDMPipeline : uint8
+{
+	/* Rules Agent first, then the Narrator Agent on its result (two round trips) */
+	AgentChain,
+	/* One request that returns both the rules result and the narration */
+	Combined
+};
+
+/* Where the manager is in the turn it is running */
+enum class EChatDMTurnPhase : uint8
+{
+	/* No turn running, the next input starts one straight away */
+	Idle,
+	/* Waiting on the rules verdict, nothing has been applied to the world yet */
+	Judging,
+	/* The verdict is applied and the narration is on its way */
+	Narrating
+};
 
 /* Handle sending HTTP requests to ChatGPT API */
 UCLASS(Blueprintable)
@@ -26,34 +50,109 @@ public:
 	UPROPERTY()
 	UNarratorAgent* NarratorAgent;
 
+	UPROPERTY()
+	UCombinedAgent* CombinedAgent;
+
 	UPROPERTY()
 	FWorldState WorldState;
 
+	/* Which request pipeline player turns go through. Switchable at runtime to A/B latency and quality. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM")
+	EChatDMPipeline Pipeline = EChatDMPipeline::AgentChain;
+
+	/* Start the narrator on a predicted rules result in parallel with the Rules Agent instead of after it */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM")
+	bool bSpeculativeNarration = false;
+
+	/* Number of speculative narrations that matched the real rules result and were committed */
+	UPROPERTY(BlueprintReadOnly, Category="ChatDM")
+	int32 SpeculationHits = 0;
+
+	/* Number of speculative narrations that were cancelled and re-issued because the prediction was wrong */
+	UPROPERTY(BlueprintReadOnly, Category="ChatDM")
+	int32 SpeculationMisses = 0;
+
+	/* Chat completions endpoint every agent talks to. Overridden by -ChatDMEndpoint= on the command line. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Connection")
+	FString EndpointUrl = TEXT("https://api.openai.com/v1/chat/completions");
+
+	/* Ping the endpoint after this many idle seconds so its connection is still open for the next turn. 0 disables. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | Connection", meta = (ClampMin = "0"))
+	float KeepAliveIntervalSeconds = 30.0f;
+
+	/* Judge trivial actions (take, go, drink) locally instead of asking the Rules Agent */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM")
+	bool bLocalRulesFastPath = true;
+
+	/* Number of agent chain turns whose rules were judged locally */
+	UPROPERTY(BlueprintReadOnly, Category="ChatDM")
+	int32 LocalRulesTurns = 0;
+
+	/* Number of agent chain turns that went to the Rules Agent */
+	UPROPERTY(BlueprintReadOnly, Category="ChatDM")
+	int32 RemoteRulesTurns = 0;
+
+	/* How long a turn should take. The narrator drops to a faster model when what the rules left of it is less than its usual latency. 0 disables. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM", meta = (ClampMin = "0"))
+	float TurnLatencyTargetSeconds = 8.0f;
+
+	/* Input sent while a turn is being narrated waits for the next turn, up to this many messages. Anything past it is dropped. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM", meta = (ClampMin = "1"))
+	int32 MaxQueuedInputs = 8;
+
+	/* Tokens used by this session's agents so far, updated at the end of every turn */
+	UPROPERTY(BlueprintReadOnly, Category="ChatDM | Metrics")
+	FChatTokenUsage TokenUsage;
+
+	/* Where the last finished turn spent its time */
+	UPROPERTY(BlueprintReadOnly, Category="ChatDM | Metrics")
+	FChatTurnMetrics LastTurnMetrics;
+
 	/* Delegate fired when we receive a response from ChatGPT */
 	UPROPERTY(BlueprintAssignable, Category="ChatDM")
 	FOnChatGptResponseReceived OnChatGptResponseReceived;
 
+	/* Delegate fired for every streamed piece of a response, before OnChatGptResponseReceived delivers the full text */
+	UPROPERTY(BlueprintAssignable, Category="ChatDM")
+	FOnChatGptResponseChunkReceived OnChatGptResponseChunkReceived;
+
 	/* Initialize fn for pulling the prompts DT and sending a setup message to ChatGPT */
 	UFUNCTION(BlueprintCallable, Category = "ChatGPT")
 	void Initialize();
 
-	/* Helper function to initialize our AI agents */
+	/* Helper function to initialize our AI agents. Starts the game in the default world unless WorldState was already filled in. */
 	void InitializeAgents();
 
+	/* The world a new game starts in */
+	static FWorldState MakeStartingWorldState();
+
 	UFUNCTION(BlueprintCallable, Category = "ChatGPT")
 	void Deinitialize();
+
+	/* Cancel everything the agents have in flight and unbind from them. Leaves the connection shared with other sessions alone. */
+	void DeinitializeAgents();
 	
 	/* Send the initial chat request to ChatGPT, which only required the Narrator Agent. */
 	UFUNCTION(BlueprintCallable, Category = "ChatDM")
 	void SendInitialChatRequest();
 	
-	/* Send a chat request to ChatGPT */
+	/* Submit player input. Turns run one at a time: input sent while the rules are still being judged is folded into
+	   that turn (which is restarted), input sent while it is being narrated waits for the next turn. */
 	UFUNCTION(BlueprintCallable, Category = "ChatDM")
 	void SendAgentChatRequest(const FString& PlayerInput);
 
+	/* Whether a turn (or the opening narration) is still running or input is waiting for one */
+	bool IsTurnInProgress() const { return TurnPhase != EChatDMTurnPhase::Idle || !QueuedInputs.IsEmpty(); }
+
+	/* Give up on the turn in progress and any input waiting behind it, without a reply. Requests in flight are cancelled. */
+	void AbandonTurn();
+
 	/* Send player input to the Rules Agent for processing */
 	void ExecuteRulesAgent(const FString& PlayerInput);
 	
+	/* Send player input to the Combined Agent, which judges the rules and narrates in one request */
+	void ExecuteCombinedAgent(const FString& PlayerInput);
+
 	/* Send player input to the Narrator Agent for processing */
 	void ExecuteNarratorAgent(const FString& PlayerInput, const FString& RulesResultJson = TEXT("N/A"), const bool bIsInitial = false);
 	
@@ -61,21 +160,81 @@ private:
 	/* We need to store all message history ourselves */
 	bool bSystemMessageSent = false;
 
-	/* For tracking the amount of tokens we use during a session */
-	int32 TokenUsage = 0;
-	
 	/* We need to store all message history ourselves */
 	TArray<FChatMessage> MessageLog;
 
+	EChatDMTurnPhase TurnPhase = EChatDMTurnPhase::Idle;
+
+	/* Input of the turn in progress, including anything coalesced into it */
+	FString ActiveTurnInput;
+
+	/* Input submitted while the current turn was being narrated, run together as the next turn */
+	TArray<FString> QueuedInputs;
+
+	/* Metrics of the turn in progress */
+	FChatTurnMetrics CurrentTurnMetrics;
+	double TurnStartTime = 0.0;
+
+	/* Start timing a new turn */
+	void BeginTurnMetrics();
+
+	/* Run a turn through the configured pipeline */
+	void StartTurn(const FString& PlayerInput);
+
+	/* The turn is over, start the next one if input is waiting */
+	void FinishTurn();
+
+	/* Cancel the requests of the turn being judged so its tokens aren't spent on an answer nobody wants */
+	void CancelJudgingRequests();
+
+	/* An agent gave up on the current turn */
+	UFUNCTION()
+	void HandleAgentRequestFailed(const FString& PlayerInput);
+
+	/* World state JSON the in-flight speculative narration was built against */
+	FString SpeculatedWorldStateJson;
+
+	/* Predicted rules result the in-flight speculative narration was built against */
+	FRulesUpdate SpeculatedRulesUpdate;
+
+	/* Kick off the narrator against a predicted rules result while the Rules Agent is still running */
+	void StartSpeculativeNarration(const FString& PlayerInput);
+
+	/* Guess the Rules Agent's verdict for the player's input. Returns false when we shouldn't speculate. */
+	bool PredictRulesUpdate(const FString& PlayerInput, FRulesUpdate& OutPrediction) const;
+
+	/* Apply a rules diff (items, enemies, inventory, current room) to the given world state */
+	static void ApplyRulesUpdate(FWorldState& State, const FRulesUpdate& RulesWorldStateUpdate);
+
+	/* Apply the turn's rules verdict to the world, timed for the turn metrics */
+	void ApplyTurnRulesUpdate(const FRulesUpdate& RulesWorldStateUpdate);
+
 	/* Handle the result of the RulesAgent processing AI's response */
 	UFUNCTION()
 	void HandleRulesResult(const FRulesUpdate& RulesWorldStateUpdate, const FString& RulesResultJson, const FString& PlayerInput);
 
+	/* Apply a rules verdict, however it was reached, and get the narration for it going */
+	void ApplyRulesResult(const FRulesUpdate& RulesWorldStateUpdate, const FString& RulesResultJson, const FString& PlayerInput);
+
+	/* Handle the result of the CombinedAgent processing AI's response */
+	UFUNCTION()
+	void HandleCombinedResult(const FRulesUpdate& RulesWorldStateUpdate, const FString& RulesResultJson, const FString& Narration, const FString& PlayerInput);
+
+	/* Make sure our narrator result and chunk handlers are bound */
+	void BindNarratorAgent();
+
 	/* Handle the result of the NarratorAgent processing AI's response */
 	UFUNCTION()
 	void HandleNarratorResult(const FString& NarratorResult, const FString& PlayerInput);
 
-	/* Helper function to convert FWorldState into JSON needed for HTTP requests. */
-	FString WorldStateToJson(const FWorldState& State);
+	/* Hand the turn's narration to listeners and end the turn */
+	void DeliverNarration(const FString& Narration);
+
+	/* Forward streamed narration to listeners as it arrives */
+	UFUNCTION()
+	void HandleNarratorChunk(const FString& Chunk, bool bIsFirstChunk);
+
+	/* Helper function to convert FWorldState into JSON needed for HTTP requests, scoped to what the given agent should see (and hasn't been sent in its DUNGEON message). */
+	FString WorldStateToJson(const FWorldState& State, const UChatAgent* ForAgent = nullptr);
 
 };
\ No newline at end of file
@@ -18,6 +18,20 @@ struct FChatMessage
 	UPROPERTY(BlueprintReadWrite, Category = "ChatMessage")
 	FString Content;
 
+	/**
+	 * Optional shorter form of Content that replaces it once a newer message is added to the log,
+	 * e.g. the player's turn without its (by then stale) world state snapshot. Empty means keep Content as is.
+	 */
+	UPROPERTY(BlueprintReadWrite, Category = "ChatMessage")
+	FString HistoryContent;
+
+	/**
+	 * This message as an encoded UTF-8 JSON object, filled in the first time it goes into a request so later requests
+	 * can copy the bytes instead of re-encoding. Must be reset whenever Role or Content change.
+	 */
+	TSharedPtr<const TArray<uint8>> EncodedJson;
+
 	FChatMessage() {}
 	FChatMessage(const FString& InRole, const FString& InContent) : Role(InRole), Content(InContent) {}
+	FChatMessage(const FString& InRole, const FString& InContent, const FString& InHistoryContent) : Role(InRole), Content(InContent), HistoryContent(InHistoryContent) {}
 };
\ No newline at end of file
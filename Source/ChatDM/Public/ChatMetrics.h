@@ -0,0 +1,122 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "ChatMetrics.generated.h"
+
+// Token counts, summed over any number of requests.
+USTRUCT(BlueprintType)
+struct FChatTokenUsage
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	int32 Requests = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	int32 PromptTokens = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	int32 CompletionTokens = 0;
+
+	/** The part of PromptTokens the server already had cached, billed and processed at a discount. */
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	int32 CachedTokens = 0;
+
+	int32 GetTotalTokens() const { return PromptTokens + CompletionTokens; }
+
+	FChatTokenUsage& operator+=(const FChatTokenUsage& Other)
+	{
+		Requests += Other.Requests;
+		PromptTokens += Other.PromptTokens;
+		CompletionTokens += Other.CompletionTokens;
+		CachedTokens += Other.CachedTokens;
+		return *this;
+	}
+};
+
+// Where one agent request spent its time, from building the body to handing over the reply.
+USTRUCT(BlueprintType)
+struct FChatRequestMetrics
+{
+	GENERATED_BODY()
+
+	/** Name of the agent that sent it. */
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	FString Agent;
+
+	/** The model that answered. */
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	FString Model;
+
+	/** Trimming the history and writing the request body. */
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	float BuildSeconds = 0.0f;
+
+	/** Waiting on the shared rate limits, over every attempt. */
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	float QueueSeconds = 0.0f;
+
+	/** From sending the answering attempt to its first response bytes. */
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	float FirstByteSeconds = 0.0f;
+
+	/** From sending the answering attempt to its last response bytes. */
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	float HttpSeconds = 0.0f;
+
+	/** Reading the reply out of the response body. */
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	float ParseSeconds = 0.0f;
+
+	/** From SendMessage to the reply being handed over. */
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	float TotalSeconds = 0.0f;
+
+	/** Attempts sent, counting retries and hedges. */
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	int32 Attempts = 0;
+
+	/** Answered from FChatResponseCache without going to the network. */
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	bool bFromCache = false;
+
+	/** Prompt tokens counted by FChatTokenizer before sending, to hold against what the server reports in Usage. */
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	int32 EstimatedPromptTokens = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	FChatTokenUsage Usage;
+};
+
+// Everything one player turn cost, from the input arriving to the narration being handed to listeners.
+USTRUCT(BlueprintType)
+struct FChatTurnMetrics
+{
+	GENERATED_BODY()
+
+	/** Requests whose replies the turn used, in the order they were answered. Locally judged rules add none. */
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	TArray<FChatRequestMetrics> Requests;
+
+	/** Applying the rules verdict to the world state. */
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	float StateApplySeconds = 0.0f;
+
+	/** Running the OnChatGptResponseReceived listeners. */
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	float BroadcastSeconds = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "ChatDM | Metrics")
+	float TotalSeconds = 0.0f;
+};
+
+// Publishes ChatDM metrics to the CSV profiler (category ChatDM, run with -csvCaptureFrames or csvprofile start)
+// and as Unreal Insights counters. The synchronous phases also show up as ChatDM_* CPU scopes in Insights.
+struct CHATDM_API FChatMetrics
+{
+	/** Report a finished request under its agent's name. */
+	static void ReportRequest(const FChatRequestMetrics& Metrics);
+
+	/** Report a finished turn, and the session's running token totals after it. */
+	static void ReportTurn(const FChatTurnMetrics& Metrics, const FChatTokenUsage& SessionUsage);
+};
\ No newline at end of file
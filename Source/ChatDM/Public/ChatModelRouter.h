@@ -0,0 +1,84 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "ChatModelRouter.generated.h"
+
+/** A model an agent can run on, and the reply length it is allowed there. */
+USTRUCT(BlueprintType)
+struct FChatModelTier
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ChatDM | Model")
+	FString Model;
+
+	/** Sent as max_tokens. 0 leaves the reply length up to the model. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ChatDM | Model", meta = (ClampMin = "0"))
+	int32 MaxTokens = 0;
+
+	FChatModelTier() {}
+	FChatModelTier(const FString& InModel, const int32 InMaxTokens) : Model(InModel), MaxTokens(InMaxTokens) {}
+};
+
+/** Which of a request's latencies a measurement is. */
+enum class EChatLatencyKind : uint8
+{
+	/** Until the first streamed text, what the player waits for when the reply is streamed. */
+	FirstToken,
+	/** Until the whole reply is in, what the player waits for when it isn't. */
+	Total,
+};
+
+// Picks which of an agent's model tiers a request runs on, from how fast each model has been answering.
+// Latencies are tracked per model across every agent and session, as separate moving averages of the time to the
+// first streamed text and to the whole reply. Game thread only.
+class CHATDM_API FChatModelRouter
+{
+public:
+	static FChatModelRouter& Get();
+
+	/**
+	 * The tier to use for a request. Starts at PreferredTier and steps down to faster (lower) tiers while the
+	 * preferred model is expected to take longer than BudgetSeconds, measured as Kind. A BudgetSeconds of 0 or less
+	 * means no budget. Models that haven't answered anything yet are assumed to fit, and so is a skipped model once
+	 * in every ProbeIntervalSeconds, so one slow spell doesn't rule it out for the rest of the session.
+	 * Returns INDEX_NONE when Tiers is empty.
+	 */
+	int32 SelectTier(const TArray<FChatModelTier>& Tiers, int32 PreferredTier, float BudgetSeconds, EChatLatencyKind Kind);
+
+	/** Record how long a model took to answer, measured as Kind. */
+	void RecordLatency(const FString& Model, EChatLatencyKind Kind, float Seconds);
+
+	/** Moving average of the model's latency measured as Kind, or a negative number when there is no such measurement yet. */
+	float GetExpectedLatency(const FString& Model, EChatLatencyKind Kind) const;
+
+	void LogStats() const;
+
+	/** How often a model that is skipped for being over budget still gets a request, to find out whether it has recovered. */
+	static constexpr double ProbeIntervalSeconds = 60.0;
+
+private:
+	FChatModelRouter() = default;
+
+	struct FLatencyStats
+	{
+		float AverageSeconds = 0.0f;
+		int32 Samples = 0;
+		/** When the last sample came in. */
+		double LastSampleTime = 0.0;
+
+		/** When SelectTier last let a request through to find out whether an over-budget model has recovered. */
+		double LastProbeTime = 0.0;
+	};
+
+	struct FModelStats
+	{
+		FLatencyStats FirstToken;
+		FLatencyStats Total;
+
+		FLatencyStats& Get(const EChatLatencyKind Kind) { return Kind == EChatLatencyKind::FirstToken ? FirstToken : Total; }
+		const FLatencyStats& Get(const EChatLatencyKind Kind) const { return Kind == EChatLatencyKind::FirstToken ? FirstToken : Total; }
+	};
+
+	TMap<FString, FModelStats> Models;
+};
\ No newline at end of file
@@ -0,0 +1,31 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "ChatMessage.h"
+
+// The DT_Prompts rows, read once and shared by every agent of every session, along with the encoded system messages
+// built from them so each session's request bodies copy the same bytes instead of holding their own.
+// Game thread only.
+class CHATDM_API FChatPromptLibrary
+{
+public:
+	static FChatPromptLibrary& Get();
+
+	/** Look up a prompt row. Returns false (and logs) when the table or row is missing. */
+	bool GetPrompt(const FName& RowName, FString& OutPrompt);
+
+	/** A system message for the prompt, already encoded, sharing its bytes with every other message made from the same prompt. */
+	FChatMessage MakeSystemMessage(const FString& Prompt);
+
+private:
+	FChatPromptLibrary() = default;
+
+	/** Copy every row out of DT_Prompts the first time a prompt is asked for. */
+	void LoadRows();
+
+	bool bRowsLoaded = false;
+	TMap<FName, FString> Rows;
+
+	/** Encoded system messages by prompt text. Only a handful of distinct prompts exist no matter how many sessions run. */
+	TMap<FString, TSharedPtr<const TArray<uint8>>> EncodedSystemMessages;
+};
\ No newline at end of file
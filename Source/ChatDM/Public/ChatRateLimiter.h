@@ -0,0 +1,115 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+#include "Interfaces/IHttpResponse.h"
+
+// Which requests go first when the rate limits don't leave room for all of them.
+enum class EChatRequestPriority : uint8
+{
+	/** The player is waiting on it. */
+	Interactive,
+	/** Work that only saves time when it pays off: speculative narration, hedged duplicates. */
+	Speculative,
+	/** Nobody is waiting on it, e.g. history summaries. */
+	Background
+};
+
+// Running totals for FChatRateLimiter, reported by the ChatDM.RateLimit.Stats console command.
+struct FChatRateLimiterStats
+{
+	/** Requests sent straight away, and those that had to wait for room in the limits first. */
+	int32 Immediate = 0;
+	int32 Delayed = 0;
+	double DelayedSeconds = 0.0;
+
+	/** Queued requests that were cancelled before they were sent. */
+	int32 Dropped = 0;
+
+	/** Queued requests whose deadline passed before there was room to send them. */
+	int32 Expired = 0;
+
+	int32 RateLimited = 0;
+};
+
+// Requests-per-minute and tokens-per-minute buckets shared by every agent of every session, so bursts wait on our
+// side instead of coming back as 429s. The buckets are set from the x-ratelimit-* response headers and drawn down by
+// an estimate of each request's tokens, corrected by the reported usage when the headers are missing.
+// Until the first headers arrive the limits are unknown and every request goes straight out.
+// Game thread only.
+class CHATDM_API FChatRateLimiter
+{
+public:
+	static FChatRateLimiter& Get();
+
+	/**
+	 * Run Launch once the limits have room for a request of about EstimatedTokens, after every queued request of
+	 * the same or higher priority. Launch returns false when the request was abandoned while it waited, in which
+	 * case it costs nothing. If it is still queued at Deadline (in FPlatformTime::Seconds(), 0 for none) it is taken
+	 * out of the queue and OnExpired runs instead of Launch.
+	 */
+	void Submit(EChatRequestPriority Priority, int32 EstimatedTokens, TFunction<bool()> Launch, double Deadline = 0.0, TFunction<void()> OnExpired = nullptr);
+
+	/** Update the buckets from a response's rate limit headers. Returns false when it had none. */
+	bool NoteResponse(const FHttpResponsePtr& Response);
+
+	/** Correct the token bucket by the difference between a request's estimate and its reported usage. */
+	void NoteUsage(int32 EstimatedTokens, int32 ActualTokens);
+
+	/** Tokens a request is likely to cost, prompt and reply together. MaxReplyTokens is the request's max_tokens, 0 for none. */
+	static int32 EstimateRequestTokens(int32 PromptTokens, int32 MaxReplyTokens);
+
+	const FChatRateLimiterStats& GetStats() const { return Stats; }
+
+	void LogStats() const;
+
+private:
+	FChatRateLimiter() = default;
+
+	struct FBucket
+	{
+		/** Zero until a response has told us the limit. */
+		double Limit = 0.0;
+		double Remaining = 0.0;
+		double RefillPerSecond = 0.0;
+	};
+
+	struct FPendingRequest
+	{
+		EChatRequestPriority Priority;
+		int32 EstimatedTokens;
+		double QueuedTime;
+		TFunction<bool()> Launch;
+		double Deadline;
+		TFunction<void()> OnExpired;
+	};
+
+	bool HasRoomFor(const FPendingRequest& Request) const;
+
+	/** Admit queued requests in order for as long as there is room. */
+	void Pump();
+
+	/** Take requests whose deadline has passed out of the queue and tell their owners. */
+	void ExpireQueued();
+
+	/** Top the buckets back up for the time passed since the last refill. */
+	void Refill();
+
+	bool Tick(float DeltaTime);
+
+	static void UpdateBucket(FBucket& Bucket, const FString& LimitHeader, const FString& RemainingHeader, const FString& ResetHeader);
+
+	FBucket Requests;
+	FBucket Tokens;
+	double LastRefillTime = 0.0;
+
+	/** Nothing goes out before this time, set when the server answers 429. */
+	double BlockedUntil = 0.0;
+
+	/** Ordered by priority, oldest first within a priority. */
+	TArray<FPendingRequest> Queue;
+
+	FTSTicker::FDelegateHandle TickerHandle;
+
+	FChatRateLimiterStats Stats;
+};
\ No newline at end of file
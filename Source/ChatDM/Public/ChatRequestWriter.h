@@ -0,0 +1,20 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "ChatMessage.h"
+
+// Writes chat-completions request bodies straight into UTF-8 bytes, without building a JSON DOM or an intermediate FString.
+struct CHATDM_API FChatRequestWriter
+{
+	/** Append a pure-ASCII literal as-is (JSON punctuation, keys, numbers). */
+	static void WriteRaw(TArray<uint8>& Out, const FAnsiStringView Literal);
+
+	/** Append Text as a quoted, escaped JSON string, transcoding to UTF-8 on the way. */
+	static void WriteString(TArray<uint8>& Out, const FStringView Text);
+
+	/** Append a {"role":...,"content":...} object. */
+	static void WriteMessage(TArray<uint8>& Out, const FStringView Role, const FStringView Content);
+
+	/** Append the message's encoded object, encoding it once and caching the bytes on the message for later requests. */
+	static void WriteCachedMessage(TArray<uint8>& Out, FChatMessage& Message);
+};
\ No newline at end of file
@@ -0,0 +1,118 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/LruCache.h"
+#include "Misc/SecureHash.h"
+#include "Tasks/Pipe.h"
+
+// Running totals for FChatResponseCache, reported by the ChatDM.ResponseCache.Stats console command.
+struct FChatResponseCacheStats
+{
+	int32 MemoryHits = 0;
+
+	/** Hits on replies that were read back from disk, i.e. written by an earlier session or pushed out of memory. */
+	int32 DiskHits = 0;
+
+	int32 Misses = 0;
+
+	/** Entry files deleted to keep the directory under its size limits. */
+	int32 Evictions = 0;
+
+	/** Size of the replies served from the cache instead of the network. */
+	int64 BytesServed = 0;
+
+	/** Sum of the original round-trip times of every reply served from the cache. */
+	double SavedSeconds = 0.0;
+
+	float GetHitRate() const
+	{
+		const int32 Lookups = MemoryHits + DiskHits + Misses;
+		return Lookups > 0 ? static_cast<float>(MemoryHits + DiskHits) / Lookups : 0.0f;
+	}
+};
+
+// Content-addressed cache of agent replies, keyed by the SHA1 of the request body (model, parameters and messages).
+// An in-memory LRU sits in front of one file per reply under Saved/ChatDM/ResponseCache, so entries survive restarts.
+// Lookups only ever read memory. The directory is indexed once in the background at startup, and every file read,
+// write and delete runs in order on a background pipe. The directory is kept under a count and byte limit by
+// deleting the least recently used files. Game thread only.
+class CHATDM_API FChatResponseCache
+{
+public:
+	static FChatResponseCache& Get();
+
+	/** The cache key for a request body. */
+	static FSHAHash MakeKey(TConstArrayView<uint8> RequestBody);
+
+	/**
+	 * Look up a reply in memory. Counts towards the hit rate. A miss on a reply that is only on disk starts loading it,
+	 * so the next identical request hits.
+	 */
+	bool Find(const FSHAHash& Key, FString& OutContent);
+
+	/** Store a reply along with how long the request took to answer, which is what each later hit saves. */
+	void Add(const FSHAHash& Key, const FString& Content, double LatencySeconds);
+
+	const FChatResponseCacheStats& GetStats() const { return Stats; }
+
+	void LogStats() const;
+
+private:
+	FChatResponseCache();
+
+	struct FEntry
+	{
+		FString Content;
+		double LatencySeconds = 0.0;
+		bool bFromDisk = false;
+	};
+
+	/** What the cache knows about an entry file without reading it. */
+	struct FDiskEntry
+	{
+		int64 Bytes = 0;
+		uint64 LastUsed = 0;
+	};
+
+	/** Result of the startup scan, newest files first. */
+	struct FDirectoryIndex
+	{
+		TArray<TPair<FSHAHash, int64>> Files;
+		TArray<TPair<FSHAHash, FEntry>> Preloaded;
+		int32 Deleted = 0;
+	};
+
+	FString GetEntryPath(const FSHAHash& Key) const;
+
+	/** Entry files are "<latency seconds>\n<reply>". */
+	static bool ParseEntryFile(const FString& FileContents, FEntry& OutEntry);
+
+	/** Scan the directory and trim it to the limits. Runs on the file pipe. */
+	FDirectoryIndex BuildDirectoryIndex() const;
+
+	/** Merge the startup scan into whatever was added while it ran. */
+	void ApplyDirectoryIndex(FDirectoryIndex&& Index);
+
+	/** Read an entry that's on disk but not in memory into memory. */
+	void LoadEntryAsync(const FSHAHash& Key);
+
+	/** Delete the least recently used entry files until the directory fits in its limits. */
+	void EnforceDiskLimits();
+
+	/** Record a hit and hand back the reply. */
+	void ServeEntry(const FEntry& Entry, FString& OutContent);
+
+	TLruCache<FSHAHash, FEntry> MemoryEntries;
+	FString Directory;
+	FChatResponseCacheStats Stats;
+
+	TMap<FSHAHash, FDiskEntry> DiskEntries;
+	int64 DiskBytes = 0;
+	uint64 UseCounter = 0;
+
+	/** Entries being read back from disk, so a burst of identical misses only loads once. */
+	TSet<FSHAHash> PendingLoads;
+
+	/** Serializes file access, so a delete never overtakes the write of the same entry or the other way around. */
+	UE::Tasks::FPipe FilePipe;
+};
\ No newline at end of file
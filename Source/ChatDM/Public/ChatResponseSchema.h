@@ -0,0 +1,16 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+// Builds OpenAI structured-output response formats from USTRUCT reflection, so a reply is guaranteed to match the struct.
+struct CHATDM_API FChatResponseSchema
+{
+	/**
+	 * The encoded {"type":"json_schema",...} object for Struct, ready to be copied into a request body.
+	 * Built from the struct's reflected properties on first use and cached for the rest of the session.
+	 */
+	static TSharedRef<const TArray<uint8>> GetResponseFormat(const UScriptStruct* Struct);
+
+	/** The JSON key a reply property is read from, the same in every build. Properties outside the reply structs get their standardized name. */
+	static FString GetJsonName(const FProperty* Property);
+};
\ No newline at end of file
@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "ChatMessage.h"
+#include "Containers/LruCache.h"
+
+// Running totals for FChatTokenizer, reported by the ChatDM.Tokenizer.Stats console command.
+struct FChatTokenizerStats
+{
+	int64 Pieces = 0;
+	int64 PieceCacheHits = 0;
+	int64 Tokens = 0;
+
+	float GetHitRate() const
+	{
+		return Pieces > 0 ? static_cast<float>(PieceCacheHits) / Pieces : 0.0f;
+	}
+};
+
+// Counts prompt tokens before a request is sent, byte-pair encoding text with a tiktoken vocab file from Content/Tokenizer
+// (o200k_base for the gpt-4o family, cl100k_base for older models). Text is split into pieces along the lines of tiktoken's
+// split pattern and each distinct piece is only merged once, since prompts repeat the same words and JSON keys every turn.
+// Without a vocab file counts fall back to about four characters a token.
+// Game thread only.
+class CHATDM_API FChatTokenizer
+{
+public:
+	/** Framing the API adds around every message, on top of its role and content. */
+	static constexpr int32 TokensPerMessage = 3;
+
+	/** Added once per prompt for the start of the assistant's reply. */
+	static constexpr int32 TokensPerReply = 3;
+
+	static FChatTokenizer& Get();
+
+	/** Tokens in Text. */
+	int32 CountTokens(FStringView Text);
+
+	/** Tokens a message costs in a prompt, framing included. */
+	int32 CountTokens(const FChatMessage& Message);
+
+	/** Tokens a whole message array costs as a prompt. */
+	int32 CountTokens(TConstArrayView<FChatMessage> Messages);
+
+	/** The token ranks for Text, without the piece cache. Empty when there is no vocab file. */
+	void Encode(FStringView Text, TArray<int32>& OutTokens);
+
+	/** Whether a vocab file was found. Loads it the first time it's asked. */
+	bool HasVocabulary();
+
+	const FChatTokenizerStats& GetStats() const { return Stats; }
+
+	void LogStats() const;
+
+private:
+	FChatTokenizer();
+
+	void LoadVocabulary();
+
+	/** Token count of one piece, from the cache or by merging it. */
+	int32 CountPiece(FStringView Piece);
+
+	/** Merge a piece's UTF-8 bytes, adding the resulting ranks to OutTokens when given. Returns the number of tokens. */
+	int32 MergeBytes(TConstArrayView<uint8> Bytes, TArray<int32>* OutTokens) const;
+
+	/** Rank of the token with exactly these bytes, MAX_int32 when there is none. */
+	int32 FindRank(const uint8* Bytes, int32 Num) const;
+
+	bool bVocabularyLoaded = false;
+	FString VocabularyName;
+
+	/** Token ranks by the CityHash64 of their bytes. A collision would put a count out by a token, fine for an estimate. */
+	TMap<uint64, int32> Ranks;
+	int32 MaxTokenBytes = 0;
+
+	/** Token counts of recently seen pieces, by the CityHash64 of their text. */
+	TLruCache<uint64, int32> PieceCounts;
+
+	FChatTokenizerStats Stats;
+};
\ No newline at end of file
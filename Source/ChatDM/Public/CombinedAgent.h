@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ChatAgent.h"
+#include "ChatMessage.h"
+#include "RulesUpdate.h"
+#include "CombinedAgent.generated.h"
+
+/** Broadcasts the rules result and the narration produced by a single combined request back to the Manager */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_FourParams(FOnCombinedResultReady, const FRulesUpdate&, RulesWorldStateUpdate, const FString&, RulesResultJson, const FString&, Narration, const FString&, PlayerInput);
+
+/**
+ * Responsible for sending messages to an AI agent that judges the rules AND narrates in one round trip
+ */
+UCLASS()
+class CHATDM_API UCombinedAgent : public UChatAgent
+{
+	GENERATED_BODY()
+
+public:
+	/** Fired when the CombinedAgent has processed the HTTP response */
+	UPROPERTY(BlueprintAssignable, Category="ChatDM | CombinedAgent")
+	FOnCombinedResultReady OnCombinedResultReady;
+
+	UCombinedAgent();
+
+	virtual void Initialize(const FString& InPrompt) override;
+
+	/** Send a message to the Combined Agent. */
+	void SendMessage(const FString& PlayerInput, const FString& WorldStateJson);
+
+private:
+	TArray<FChatMessage> MessageLog;
+
+	virtual void HandleResponse(const FString& ResponseContent, const FString& PlayerInput) override;
+
+	virtual void AbandonTurn() override;
+};
\ No newline at end of file
@@ -0,0 +1,20 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "RulesUpdate.h"
+#include "CombinedTurnResult.generated.h"
+
+// Represents a CombinedAgent response: the rules verdict and the narration for the same turn.
+USTRUCT(BlueprintType)
+struct FCombinedTurnResult
+{
+	GENERATED_BODY()
+
+	/** The rules evaluation, in the same shape the Rules Agent returns. */
+	UPROPERTY(meta = (JsonProperty = "rules"))
+	FRulesUpdate Rules;
+
+	/** The narration shown to the player. */
+	UPROPERTY(meta = (JsonProperty = "narration"))
+	FString Narration;
+};
\ No newline at end of file
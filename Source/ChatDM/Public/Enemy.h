@@ -13,9 +13,9 @@ struct FEnemy
 	UPROPERTY(meta = (JsonProperty = "enemyIndex"))
 	int32 EnemyIndex;
 
-	/** The enemy's name. */
+	/** The enemy's name, which rules updates find it by. */
 	UPROPERTY(meta = (JsonProperty = "name"))
-	FString Name;
+	FName Name;
 
 	/** The enemy's current HP. */
 	UPROPERTY(meta = (JsonProperty = "health"))
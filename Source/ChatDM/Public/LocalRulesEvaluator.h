@@ -0,0 +1,14 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "RulesUpdate.h"
+#include "WorldState.h"
+
+// Judges mechanically trivial player actions (taking an item, walking through an exit, drinking a potion) locally,
+// producing the same FRulesUpdate the Rules Agent would. Deliberately conservative: any phrasing it doesn't fully
+// understand, any ambiguity, and anything done with an active enemy in the room is left to the Rules Agent.
+struct CHATDM_API FLocalRulesEvaluator
+{
+	/** Returns true and fills OutRulesUpdate when the action could be judged locally. */
+	static bool TryEvaluate(const FString& PlayerInput, const FWorldState& State, FRulesUpdate& OutRulesUpdate);
+};
\ No newline at end of file
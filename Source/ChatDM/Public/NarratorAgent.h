@@ -9,6 +9,9 @@
 /** Broadcasts the final result of the narration back to the Manager */
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnNarratorResultReady, const FString&, Result, const FString&, PlayerInput);
 
+/** Broadcasts each piece of narration as it streams in, before the final result is ready */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnNarratorChunkReceived, const FString&, Chunk, bool, bIsFirstChunk);
+
 /**
  * Responsible for sending messages to the AI Narrator Agent 
  */
@@ -21,19 +24,117 @@ public:
 	/** Fired when the RulesAgent has processed the HTTP response */
 	UPROPERTY(BlueprintAssignable, Category="ChatDM | NarratorAgent")
 	FOnNarratorResultReady OnNarratorResultReady;
+
+	/** Fired for every streamed piece of narration while the response is still being generated */
+	UPROPERTY(BlueprintAssignable, Category="ChatDM | NarratorAgent")
+	FOnNarratorChunkReceived OnNarratorChunkReceived;
+
+	/** Whether narration should be streamed back as it is generated instead of waiting for the full response. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | NarratorAgent")
+	bool bStreamResponses = true;
+
+	/** Whether old turns get compacted into a "story so far" message in the background. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | NarratorAgent | Summary")
+	bool bSummarizeHistory = true;
+
+	/** Estimated history size (tokens) that triggers a background summary. Keep below MaxContextTokens so turns get summarized before they are trimmed. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | NarratorAgent | Summary", meta = (ClampMin = "1"))
+	int32 SummarizeThresholdTokens = 6000;
+
+	/** Number of newest turns that are always left verbatim. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | NarratorAgent | Summary", meta = (ClampMin = "0"))
+	int32 SummaryKeepRecentTurns = 4;
+
+	/** Cheap model used to write the summaries. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ChatDM | NarratorAgent | Summary")
+	FString SummaryModel = TEXT("gpt-4o-mini");
+
+	/** Estimated history tokens before and after the last summary was swapped in. */
+	UPROPERTY(BlueprintReadOnly, Category="ChatDM | NarratorAgent | Summary")
+	int32 LastSummaryTokensBefore = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category="ChatDM | NarratorAgent | Summary")
+	int32 LastSummaryTokensAfter = 0;
 	
+	UNarratorAgent();
+
 	virtual void Initialize(const FString& InPrompt) override;
 
 	void SendInitialMessage(const FString& WorldStateJson);
 	
-	/** Send a message to the Narrator Agent. */
-	void SendMessage(const FString& PlayerInput, const FString& CurrentWorldStateJson, const FString& RulesResultJson);
+	/** Send a message to the Narrator Agent. With a latency budget the narration drops to a faster model when its usual one wouldn't make it. */
+	void SendMessage(const FString& PlayerInput, const FString& CurrentWorldStateJson, const FString& RulesResultJson, float LatencyBudgetSeconds = 0.0f);
+
+	/**
+	 * Start narrating a turn against a predicted rules result while the Rules Agent is still working.
+	 * Nothing is added to the message log or broadcast until CommitSpeculation() is called.
+	 */
+	void SendSpeculativeMessage(const FString& PlayerInput, const FString& PredictedWorldStateJson, const FString& PredictedRulesResultJson);
+
+	/** The prediction held: record the turn against the real rules result and deliver the narration, now or as soon as it arrives. */
+	void CommitSpeculation(const FString& RulesResultJson);
+
+	/** The prediction missed: cancel the in-flight request and forget the turn. */
+	void CancelSpeculation();
+
+	bool HasSpeculation() const { return Speculation.IsSet(); }
+
+	/** Cancel the turn in progress, any speculation and any background summary. */
+	virtual void CancelRequests() override;
 
 private:
+	/** A narrator turn started ahead of the rules result. */
+	struct FSpeculativeTurn
+	{
+		TSharedPtr<FChatRequestHandle> Request;
+		FChatMessage UserMessage;
+		FString WorldStateJson;
+		FString PlayerInput;
+		FString StreamedText;
+		FString Response;
+		bool bResponseReady = false;
+		bool bCommitted = false;
+	};
+
+	/** A finished summary waiting for a turn boundary to be swapped in. */
+	struct FPendingSummary
+	{
+		/** Number of messages after the system prompt that the summary replaces. */
+		int32 NumMessages = 0;
+		/** Hash of those messages when they were sent off, to detect that the log moved underneath us. */
+		uint32 SourceHash = 0;
+		FString Summary;
+	};
+
 	TArray<FChatMessage> MessageLog;
 
+	TOptional<FSpeculativeTurn> Speculation;
+
+	/** True from sending a player turn until its response is handled. Summaries are never swapped in while set. */
+	bool bTurnInFlight = false;
+
+	TSharedPtr<FChatRequestHandle> SummaryRequest;
+	TOptional<FPendingSummary> PendingSummary;
+
 	FString StartupPrompt;
 	
 	virtual void HandleResponse(const FString& ResponseContent, const FString& PlayerInput) override;
+
+	virtual void AbandonTurn() override;
+
+	/** Builds the request options for a turn, hooking up chunk broadcasts when streaming is enabled. */
+	FChatRequestOptions MakeRequestOptions(const FString& PlayerInput);
+
+	/** Record a committed speculative turn once both the commit and the response have happened. */
+	void FinishSpeculation();
+
+	/** Start a background summary of the oldest turns if the history has grown past the threshold. */
+	void MaybeSummarizeHistory();
+
+	/** Swap a finished summary into the log, if it still matches what was summarized. */
+	void ApplyPendingSummary();
+
+	/** Hash of MessageLog[1, 1 + NumMessages), i.e. everything after the system prompt up to NumMessages. */
+	uint32 HashHistoryPrefix(int32 NumMessages) const;
 	
 };
\ No newline at end of file
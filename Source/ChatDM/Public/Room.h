@@ -19,6 +19,7 @@ struct FRoom
 	UPROPERTY(meta = (JsonProperty = "description"))
 	FString Description;
 
+	/** Kept as strings: the Rules Agent can name new items at any time, and interning each one would grow the name table for good. */
 	UPROPERTY(meta = (JsonProperty = "items"))
 	TArray<FString> Items;
 
@@ -26,7 +27,21 @@ struct FRoom
 	TArray<FEnemy> Enemies;
 
 	UPROPERTY(meta = (JsonProperty = "exits"))
-	TArray<FString> Exits;
+	TArray<FName> Exits;
+
+	/** Room index each exit leads to, parallel to Exits. Missing or -1 means the destination isn't known. */
+	UPROPERTY(meta = (JsonProperty = "exitRoomIndices"))
+	TArray<int32> ExitRoomIndices;
+
+	/** Slot in Enemies by name. Filled in by BuildIndexes(); lookups fall back to a scan if Enemies was edited since. */
+	TMap<FName, int32> EnemySlots;
+
+	/** The enemy with this name, the first one if several share it. Nullptr when there is none. */
+	const FEnemy* FindEnemy(FName EnemyName) const;
+	FEnemy* FindEnemy(const FName EnemyName) { return const_cast<FEnemy*>(AsConst(*this).FindEnemy(EnemyName)); }
+
+	/** Index the enemies, after they were added, removed or renamed. */
+	void BuildIndexes();
 };
 
 // Reduced size struct for rules updates.
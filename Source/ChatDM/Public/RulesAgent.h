@@ -23,15 +23,29 @@ public:
 	UPROPERTY(BlueprintAssignable, Category="ChatDM | RulesAgent")
 	FOnRulesResultReady OnRulesResultReady;
 	
+	URulesAgent();
+
 	virtual void Initialize(const FString& InPrompt) override;
 
 	/** Send a message to the Rules Agent. */
 	void SendMessage(const FString& PlayerInput, const FString& WorldStateJson);
 
+	/**
+	 * Clean up an AI rules response and convert it into an FRulesUpdate. Shared with agents that embed a rules result.
+	 * Returns false when no rules result could be found. bOutTruncated, when given, is set if the reply was cut off and had to be closed.
+	 */
+	static bool JsonToRulesUpdate(const FString& InJson, FRulesUpdate& OutRulesUpdate, FString& OutRulesResultJson, bool* bOutTruncated = nullptr);
+
 private:
 	TArray<FChatMessage> MessageLog;
 
+	/** The model tier the turn in progress was sent to. */
+	int32 ActiveModelTier = 0;
+
+	/** Send the newest message in the log on the given model tier. */
+	void SendTurn(const FString& PlayerInput, int32 ModelTier);
+
 	virtual void HandleResponse(const FString& ResponseContent, const FString& PlayerInput) override;
 
-	void JsonToRulesUpdate(const FString& InJson, FRulesUpdate& OutRulesUpdate, FString& OutRulesResultJson);
+	virtual void AbandonTurn() override;
 };
\ No newline at end of file
@@ -14,7 +14,7 @@ struct FRulesUpdate
 	UPROPERTY(meta = (JsonProperty = "success"))
 	bool bSuccess;
 
-	/** The reason for why bSuccess is true or false. */
+	/** Why the action succeeded or failed. */
 	UPROPERTY(meta = (JsonProperty = "reason"))
 	FString Reason;
 
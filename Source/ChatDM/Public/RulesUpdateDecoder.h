@@ -0,0 +1,19 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "RulesUpdate.h"
+
+// Single-pass decoder from a Rules Agent reply straight into FRulesUpdate, without a JSON DOM or reflection.
+// Tolerates the usual model glitches: code fences, a BOM, prose around the object, trailing or missing commas,
+// and a reply cut off between members before its closing braces. A reply cut off inside a key, a value or an
+// array is rejected, since what arrived of it would read as the whole thing.
+struct CHATDM_API FRulesUpdateDecoder
+{
+	/**
+	 * Decode the first JSON object in Text that looks like a rules result.
+	 * OutJson receives that object's text, with any missing closing braces appended.
+	 * bOutTruncated, when given, is set if the closing braces had to be made up.
+	 * Returns false if no such object was found, in which case OutRulesUpdate is left default-initialized.
+	 */
+	static bool Decode(const FStringView Text, FRulesUpdate& OutRulesUpdate, FString& OutJson, bool* bOutTruncated = nullptr);
+};
\ No newline at end of file
@@ -17,8 +17,26 @@ struct FWorldState
 	UPROPERTY(meta = (JsonProperty = "currentRoomIndex"))
 	int32 CurrentRoomIndex = 0;
 
+	/** Strings like FRoom::Items, since the Rules Agent names them. */
 	UPROPERTY(meta = (JsonProperty = "playerHeldItems"))
 	TArray<FString> PlayerHeldItems;
+
+	/** Slot in Rooms by RoomIndex. Filled in by BuildIndexes(); lookups fall back to a scan if Rooms was edited since. */
+	TMap<int32, int32> RoomSlots;
+
+	/** Slot in Rooms of the room with this RoomIndex, INDEX_NONE when there is none. */
+	int32 FindRoomSlot(int32 RoomIndex) const;
+
+	/** The room with this RoomIndex, nullptr when there is none. */
+	const FRoom* FindRoom(const int32 RoomIndex) const
+	{
+		const int32 Slot = FindRoomSlot(RoomIndex);
+		return Slot != INDEX_NONE ? &Rooms[Slot] : nullptr;
+	}
+	FRoom* FindRoom(const int32 RoomIndex) { return const_cast<FRoom*>(AsConst(*this).FindRoom(RoomIndex)); }
+
+	/** Index the rooms and every room's enemies, after building or loading a world. */
+	void BuildIndexes();
 };
 
 // Reduced size struct for rules updates.
@@ -30,6 +48,9 @@ struct FWorldStateUpdate
 	UPROPERTY(meta = (JsonProperty = "currentRoomIndex"))
 	int32 CurrentRoomIndex = 0;
 
+	/** Whether the update gives CurrentRoomIndex at all. Without it the player stays where they are. */
+	bool bHasCurrentRoomIndex = false;
+
 	UPROPERTY(meta = (JsonProperty = "playerHeldItems"))
 	TArray<FString> PlayerHeldItems;
 
@@ -0,0 +1,71 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "WorldState.h"
+#include "WorldStateView.generated.h"
+
+// How much of the world an agent gets to see in its WORLDSTATE block.
+UENUM(BlueprintType)
+enum class EWorldStateScope : uint8
+{
+	/** Every room in the dungeon. */
+	FullWorld,
+	/** The current room plus the rooms reachable through its exits, up to Depth steps away. */
+	Neighborhood
+};
+
+// Text encoding used for the WORLDSTATE block.
+UENUM(BlueprintType)
+enum class EWorldStateFormat : uint8
+{
+	/** Reflection-driven JSON with indentation and full property names (the original format). */
+	PrettyJson,
+	/** Same keys, no whitespace. */
+	MinifiedJson,
+	/** Minified JSON with short keys and enemies as rows; agents are told the schema once in a system message. */
+	Compact
+};
+
+// Which parts of FWorldState a view includes. Room names, descriptions and exits never change during a game, the rest can.
+enum class EWorldStateParts : uint8
+{
+	/** Room names, descriptions and exits. */
+	Static = 1 << 0,
+	/** The current room, the player's items, and every room's items and enemies. */
+	Volatile = 1 << 1,
+	All = Static | Volatile
+};
+ENUM_CLASS_FLAGS(EWorldStateParts);
+
+// Per-agent settings for how FWorldState is turned into prompt text.
+USTRUCT(BlueprintType)
+struct FWorldStateViewSettings
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WorldStateView")
+	EWorldStateScope Scope = EWorldStateScope::FullWorld;
+
+	/** Number of exits to follow out of the current room when Scope is Neighborhood. 0 means the current room only. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WorldStateView", meta = (ClampMin = "0"))
+	int32 Depth = 1;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WorldStateView")
+	EWorldStateFormat Format = EWorldStateFormat::PrettyJson;
+};
+
+// Builds the views of FWorldState that are sent to the agents.
+struct CHATDM_API FWorldStateView
+{
+	/** Copy of State holding only the current room and the rooms within Depth exits of it, plus the player's items. */
+	static FWorldState BuildNeighborhood(const FWorldState& State, int32 Depth);
+
+	/** Serialize State for an agent according to its view settings. Rooms always keep their index so the parts can be matched up. */
+	static FString ToJson(const FWorldState& State, const FWorldStateViewSettings& Settings, EWorldStateParts Parts = EWorldStateParts::All);
+
+	/** Short-key encoding of State, see GetFormatLegend() for the schema. */
+	static FString ToCompactJson(const FWorldState& State, EWorldStateParts Parts = EWorldStateParts::All);
+
+	/** Explanation of the given format for the system prompt, empty when the format is self-describing. */
+	static const FString& GetFormatLegend(EWorldStateFormat Format);
+};
\ No newline at end of file